@@ -0,0 +1,17 @@
+// Resource arrays of the ComputeBindlessHeap, include this in shaders which call ComputeShader::SetBindless(true).
+// Resources are addressed by the indices returned when they were registered, usually passed in push constants.
+// The shader's own bindings are in set 1.
+
+#extension GL_EXT_nonuniform_qualifier : enable
+
+// storage images, the same binding declared once per format
+layout (set = 0, binding = 0, rgba8) uniform image2D bindlessImagesRGBA8[];
+layout (set = 0, binding = 0, rgba16f) uniform image2D bindlessImagesRGBA16F[];
+layout (set = 0, binding = 0, rgba32f) uniform image2D bindlessImagesRGBA32F[];
+
+layout (set = 0, binding = 1) uniform sampler2D bindlessTextures[];
+
+layout (set = 0, binding = 2) buffer BindlessBuffer
+{
+	uint data[];
+} bindlessBuffers[];
@@ -1,5 +1,67 @@
-set EXEPATH=D:\UltraEngineClient/Tools/glSlangValidator.exe
-"%EXEPATH%" "simple_test.comp" -V -o "simple_test.comp.spv"
-"%EXEPATH%" "simple_test_push.comp" -V -o "simple_test_push.comp.spv"
-pause
+@echo off
+rem Compiles every compute shader in this folder to SPIR-V, runs the spirv-opt performance passes
+rem when the optimizer is available and embeds the result into Source\Compute\Generated\EmbeddedShaders.h
+rem Called by the pre-build step with /nopause and the intermediate folder, can still be run by hand.
+rem   compile.bat [/nopause] [/updateprebuilt] [output folder]
+rem The binaries go to the output folder (Intermediate\Shaders\Compute by default), a build never writes to this folder.
+rem Without glslangValidator the binaries in Prebuilt are embedded, a missing or out of date one is replaced by a
+rem placeholder with a warning and that shader fails to create its pipeline at run time.
+rem After changing a shader run compile.bat /updateprebuilt and commit Prebuilt, so machines without the SDK can build.
+setlocal enabledelayedexpansion
+cd /d "%~dp0"
 
+set NOPAUSE=
+set UPDATEPREBUILT=
+set "OUTDIR=%~dp0..\..\Intermediate\Shaders\Compute"
+:parse
+if "%~1"=="" goto parsed
+if /i "%~1"=="/nopause" (
+	set NOPAUSE=1
+) else if /i "%~1"=="/updateprebuilt" (
+	set UPDATEPREBUILT=1
+) else (
+	set "OUTDIR=%~f1"
+)
+shift
+goto parse
+:parsed
+if not exist "%OUTDIR%" mkdir "%OUTDIR%"
+
+set GLSLANG=
+if exist "%UltraEnginePath%\Tools\glslangValidator.exe" set "GLSLANG=%UltraEnginePath%\Tools\glslangValidator.exe"
+if not defined GLSLANG if exist "%VULKAN_SDK%\Bin\glslangValidator.exe" set "GLSLANG=%VULKAN_SDK%\Bin\glslangValidator.exe"
+if not defined GLSLANG for %%i in (glslangValidator.exe) do set "GLSLANG=%%~$PATH:i"
+
+set SPIRVOPT=
+if exist "%VULKAN_SDK%\Bin\spirv-opt.exe" set "SPIRVOPT=%VULKAN_SDK%\Bin\spirv-opt.exe"
+if not defined SPIRVOPT for %%i in (spirv-opt.exe) do set "SPIRVOPT=%%~$PATH:i"
+
+set RESULT=0
+set EMBEDARGS=-InputDir "%OUTDIR%"
+
+if defined GLSLANG (
+	if not defined SPIRVOPT echo warning: spirv-opt not found, the embedded shaders are not optimized
+	for %%f in (*.comp) do (
+		rem a failed compile must not leave the binary of an earlier build behind
+		del /q "!OUTDIR!\%%f.spv" 2>nul
+		"!GLSLANG!" -V --target-env vulkan1.1 "%%f" -o "!OUTDIR!\%%f.spv" || set "RESULT=1"
+		if defined SPIRVOPT if exist "!OUTDIR!\%%f.spv" (
+			"!SPIRVOPT!" -O "!OUTDIR!\%%f.spv" -o "!OUTDIR!\%%f.opt.spv" && move /y "!OUTDIR!\%%f.opt.spv" "!OUTDIR!\%%f.spv" >nul || set "RESULT=1"
+		)
+	)
+	if defined UPDATEPREBUILT if !RESULT!==0 set "EMBEDARGS=!EMBEDARGS! -UpdatePrebuilt"
+) else (
+	if defined UPDATEPREBUILT (
+		echo error: glslangValidator not found, the prebuilt binaries can't be updated
+		set RESULT=1
+	)
+	echo warning: glslangValidator not found, embedding the binaries from Shaders\Compute\Prebuilt
+	set "EMBEDARGS=!EMBEDARGS! -UsePrebuilt"
+)
+
+if %RESULT%==0 (
+	powershell -NoProfile -ExecutionPolicy Bypass -File "embed_shaders.ps1" -OutputFile "..\..\Source\Compute\Generated\EmbeddedShaders.h" %EMBEDARGS% || set "RESULT=1"
+)
+
+if not defined NOPAUSE pause
+exit /b %RESULT%
@@ -0,0 +1,163 @@
+# Writes the SPIR-V of every *.comp of this folder as a constexpr uint32_t array into a C++ header.
+# The binaries are read from InputDir, or from Prebuilt with -UsePrebuilt. A shader which failed to compile fails the
+# build. Prebuilt binaries are refused when their source (or a file it includes) changed since they were made,
+# Prebuilt\sources.txt records the hash of the sources they were built from. Without the SDK a shader with no usable
+# prebuilt binary is embedded as a one word placeholder, so the project still builds and only that shader fails to
+# create its pipeline at run time.
+# -UpdatePrebuilt copies the binaries of InputDir into Prebuilt and rewrites sources.txt.
+# The header is only rewritten when its content changes, so unchanged shaders do not trigger a rebuild.
+param(
+	[Parameter(Mandatory = $true)][string]$OutputFile,
+	[string]$InputDir = "",
+	[switch]$UsePrebuilt,
+	[switch]$UpdatePrebuilt
+)
+
+$prebuiltDir = Join-Path $PSScriptRoot "Prebuilt"
+$manifestFile = Join-Path $prebuiltDir "sources.txt"
+
+# Source text with the files it includes, line endings normalized so checkouts with CRLF hash the same
+function Get-SourceText([string]$path, [System.Collections.Generic.HashSet[string]]$visited)
+{
+	if (-not $visited.Add([System.IO.Path]::GetFullPath($path)))
+	{
+		return ""
+	}
+	if (-not (Test-Path $path))
+	{
+		Write-Error "$path is included but does not exist"
+		exit 1
+	}
+
+	$text = [System.IO.File]::ReadAllText($path).Replace("`r`n", "`n")
+	$result = $text
+	foreach ($match in [regex]::Matches($text, '(?m)^\s*#\s*include\s+"([^"]+)"'))
+	{
+		$result += Get-SourceText (Join-Path (Split-Path $path) $match.Groups[1].Value) $visited
+	}
+	return $result
+}
+
+function Get-SourceHash([string]$path)
+{
+	$visited = New-Object System.Collections.Generic.HashSet[string]
+	$bytes = [System.Text.Encoding]::UTF8.GetBytes((Get-SourceText $path $visited))
+	$sha = [System.Security.Cryptography.SHA256]::Create()
+	return ([BitConverter]::ToString($sha.ComputeHash($bytes)) -replace "-", "").ToLowerInvariant()
+}
+
+$manifest = @{}
+if (Test-Path $manifestFile)
+{
+	foreach ($line in [System.IO.File]::ReadAllLines($manifestFile))
+	{
+		$parts = $line.Split(" ", [System.StringSplitOptions]::RemoveEmptyEntries)
+		if ($parts.Length -eq 2)
+		{
+			$manifest[$parts[0]] = $parts[1]
+		}
+	}
+}
+
+$sources = Get-ChildItem -Path $PSScriptRoot -Filter "*.comp" | Sort-Object Name
+
+if ($UpdatePrebuilt)
+{
+	New-Item -ItemType Directory -Force -Path $prebuiltDir | Out-Null
+	$lines = @()
+	foreach ($source in $sources)
+	{
+		Copy-Item -Force (Join-Path $InputDir "$($source.Name).spv") (Join-Path $prebuiltDir "$($source.Name).spv") -ErrorAction Stop
+		$lines += "$($source.Name) $(Get-SourceHash $source.FullName)"
+	}
+	[System.IO.File]::WriteAllText($manifestFile, ($lines -join "`n") + "`n")
+}
+
+$builder = New-Object System.Text.StringBuilder
+[void]$builder.AppendLine("// Generated by Shaders/Compute/compile.bat from the compute shader sources, do not edit.")
+[void]$builder.AppendLine("#pragma once")
+[void]$builder.AppendLine("#include <cstdint>")
+[void]$builder.AppendLine("")
+[void]$builder.AppendLine("namespace UltraEngine::Compute::EmbeddedShaders")
+[void]$builder.AppendLine("{")
+
+$failed = $false
+foreach ($source in $sources)
+{
+	$name = ($source.Name -replace "\.comp$", "") -replace "[^A-Za-z0-9_]", "_"
+	if ($UsePrebuilt)
+	{
+		$file = Join-Path $prebuiltDir "$($source.Name).spv"
+		$problem = $null
+		if (-not (Test-Path $file))
+		{
+			$problem = "Prebuilt\$($source.Name).spv is missing"
+		}
+		elseif ($manifest[$source.Name] -ne (Get-SourceHash $source.FullName))
+		{
+			$problem = "$($source.Name) changed since Prebuilt\$($source.Name).spv was built"
+		}
+		elseif ((Get-Item $file).Length -eq 0 -or (Get-Item $file).Length % 4 -ne 0)
+		{
+			$problem = "Prebuilt\$($source.Name).spv is not a valid SPIR-V binary"
+		}
+		if ($problem -ne $null)
+		{
+			Write-Host "warning: $problem, $name is embedded without code and fails at run time. Run compile.bat /updateprebuilt where the Vulkan SDK is installed"
+			[void]$builder.AppendLine("`t// placeholder, $problem")
+			[void]$builder.AppendLine("`tconstexpr uint32_t $name[] = { 0 };")
+			[void]$builder.AppendLine("")
+			continue
+		}
+	}
+	else
+	{
+		$file = Join-Path $InputDir "$($source.Name).spv"
+		if (-not (Test-Path $file))
+		{
+			Write-Host "error: $($source.Name) was not compiled, $file is missing"
+			$failed = $true
+			continue
+		}
+	}
+
+	$bytes = [System.IO.File]::ReadAllBytes($file)
+	if ($bytes.Length -eq 0 -or $bytes.Length % 4 -ne 0)
+	{
+		Write-Host "error: $file is not a valid SPIR-V binary"
+		$failed = $true
+		continue
+	}
+
+	[void]$builder.AppendLine("`tconstexpr uint32_t $name[] =")
+	[void]$builder.AppendLine("`t{")
+	for ($i = 0; $i -lt $bytes.Length; $i += 32)
+	{
+		$words = @()
+		for ($j = $i; $j -lt [Math]::Min($i + 32, $bytes.Length); $j += 4)
+		{
+			$words += "0x{0:x8}" -f [BitConverter]::ToUInt32($bytes, $j)
+		}
+		[void]$builder.AppendLine("`t`t" + ($words -join ", ") + ",")
+	}
+	[void]$builder.AppendLine("`t};")
+	[void]$builder.AppendLine("")
+}
+
+if ($failed)
+{
+	exit 1
+}
+
+[void]$builder.AppendLine("}")
+
+$output = Join-Path $PSScriptRoot $OutputFile
+$content = $builder.ToString()
+if ((Test-Path $output) -and ([System.IO.File]::ReadAllText($output) -eq $content))
+{
+	exit 0
+}
+
+New-Item -ItemType Directory -Force -Path (Split-Path $output) | Out-Null
+[System.IO.File]::WriteAllText($output, $content)
+exit 0
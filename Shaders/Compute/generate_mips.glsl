@@ -0,0 +1,150 @@
+// Single pass mip chain generation.
+// Every workgroup reduces a 64x64 tile of the base level down to mips 1 - 6. The last workgroup of a layer
+// to finish (found with a global atomic counter) then reduces the 64x64 texels of mip 6 down to mips 7 - 12.
+// gl_WorkGroupID.z selects the array layer / cube face.
+// Included by the generate_mips*.comp variants, which define MIP_FORMAT as the storage format of the texture.
+
+layout (local_size_x = 256) in;
+
+// mips[0] is the base level, unused slots repeat the last level
+layout (set = 0, binding = 0, MIP_FORMAT) uniform coherent image2DArray mips[13];
+
+layout (set = 0, binding = 1) coherent buffer Counters
+{
+	uint counter[];
+} counters;
+
+layout (push_constant) uniform Constants
+{
+	uint mipCount;
+	uint workGroupCount;
+} params;
+
+shared vec4 tile[16][16];
+shared uint finishedGroups;
+
+vec4 loadMip(int level, ivec3 p)
+{
+	// clamp to the edge for sizes which are not a multiple of 64
+	ivec2 size = ivec2(1);
+	switch (level)
+	{
+	case 0: size = imageSize(mips[0]).xy; break;
+	case 6: size = imageSize(mips[6]).xy; break;
+	}
+	p.xy = min(p.xy, size - 1);
+
+	switch (level)
+	{
+	case 0: return imageLoad(mips[0], p);
+	case 6: return imageLoad(mips[6], p);
+	}
+	return vec4(0.0);
+}
+
+void storeMip(int level, ivec3 p, vec4 value)
+{
+	if (level > int(params.mipCount))
+	{
+		return;
+	}
+
+	switch (level)
+	{
+	case 1: if (all(lessThan(p.xy, imageSize(mips[1]).xy))) imageStore(mips[1], p, value); break;
+	case 2: if (all(lessThan(p.xy, imageSize(mips[2]).xy))) imageStore(mips[2], p, value); break;
+	case 3: if (all(lessThan(p.xy, imageSize(mips[3]).xy))) imageStore(mips[3], p, value); break;
+	case 4: if (all(lessThan(p.xy, imageSize(mips[4]).xy))) imageStore(mips[4], p, value); break;
+	case 5: if (all(lessThan(p.xy, imageSize(mips[5]).xy))) imageStore(mips[5], p, value); break;
+	case 6: if (all(lessThan(p.xy, imageSize(mips[6]).xy))) imageStore(mips[6], p, value); break;
+	case 7: if (all(lessThan(p.xy, imageSize(mips[7]).xy))) imageStore(mips[7], p, value); break;
+	case 8: if (all(lessThan(p.xy, imageSize(mips[8]).xy))) imageStore(mips[8], p, value); break;
+	case 9: if (all(lessThan(p.xy, imageSize(mips[9]).xy))) imageStore(mips[9], p, value); break;
+	case 10: if (all(lessThan(p.xy, imageSize(mips[10]).xy))) imageStore(mips[10], p, value); break;
+	case 11: if (all(lessThan(p.xy, imageSize(mips[11]).xy))) imageStore(mips[11], p, value); break;
+	case 12: if (all(lessThan(p.xy, imageSize(mips[12]).xy))) imageStore(mips[12], p, value); break;
+	}
+}
+
+// Reduces the 64x64 texel tile of sourceLevel starting at tileOrigin down to the six following levels
+void downsampleTile(int sourceLevel, ivec2 tileOrigin, int layer)
+{
+	uint index = gl_LocalInvocationIndex;
+	ivec2 thread = ivec2(index % 16, index / 16);
+
+	// first level: every thread writes 2x2 texels from a 4x4 source block
+	vec4 sum = vec4(0.0);
+	for (int y = 0; y < 2; y++)
+	{
+		for (int x = 0; x < 2; x++)
+		{
+			ivec2 p = tileOrigin / 2 + thread * 2 + ivec2(x, y);
+			vec4 value = (loadMip(sourceLevel, ivec3(p * 2, layer))
+				+ loadMip(sourceLevel, ivec3(p * 2 + ivec2(1, 0), layer))
+				+ loadMip(sourceLevel, ivec3(p * 2 + ivec2(0, 1), layer))
+				+ loadMip(sourceLevel, ivec3(p * 2 + ivec2(1, 1), layer))) * 0.25;
+			storeMip(sourceLevel + 1, ivec3(p, layer), value);
+			sum += value;
+		}
+	}
+
+	// second level: one texel per thread, kept in shared memory for the remaining levels
+	vec4 value = sum * 0.25;
+	storeMip(sourceLevel + 2, ivec3(tileOrigin / 4 + thread, layer), value);
+	tile[thread.y][thread.x] = value;
+	barrier();
+
+	for (int level = 3; level <= 6; level++)
+	{
+		int size = 64 >> level;
+		ivec2 p = ivec2(int(index) % size, int(index) / size);
+		bool active = int(index) < size * size;
+
+		if (active)
+		{
+			value = (tile[p.y * 2][p.x * 2] + tile[p.y * 2][p.x * 2 + 1] + tile[p.y * 2 + 1][p.x * 2] + tile[p.y * 2 + 1][p.x * 2 + 1]) * 0.25;
+			storeMip(sourceLevel + level, ivec3(tileOrigin / (1 << level) + p, layer), value);
+		}
+		barrier();
+
+		if (active)
+		{
+			tile[p.y][p.x] = value;
+		}
+		barrier();
+	}
+}
+
+void main()
+{
+	int layer = int(gl_WorkGroupID.z);
+	downsampleTile(0, ivec2(gl_WorkGroupID.xy) * 64, layer);
+
+	if (params.mipCount <= 6)
+	{
+		return;
+	}
+
+	// make mip 6 of this tile visible to the workgroup which finishes last, before the counter tells it this group is done
+	memoryBarrier();
+	barrier();
+
+	if (gl_LocalInvocationIndex == 0)
+	{
+		finishedGroups = atomicAdd(counters.counter[layer], 1);
+	}
+	barrier();
+
+	if (finishedGroups != params.workGroupCount - 1)
+	{
+		return;
+	}
+
+	if (gl_LocalInvocationIndex == 0)
+	{
+		// ready for the next dispatch
+		counters.counter[layer] = 0;
+	}
+
+	downsampleTile(6, ivec2(0), layer);
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include "UltraEngine.h"
+#include <chrono>
 
 using namespace UltraEngine;
 
@@ -10,28 +11,42 @@ public:
     Vec3 movementspeed;
     Vec3 rotationspeed;
     bool globalcoords;
+    // Set while a MoverSystem moves the entity, the speeds are then changed through the system
+    bool batched;
+    std::chrono::steady_clock::time_point lastupdate;
     
     Mover::Mover()
     { 
         globalcoords = false;
+        batched = false;
     }
 
     virtual void Update()
     {
+        if (batched) return;
+
+        // the speeds are given per second, the first update assumes 60 Hz
+        auto now = std::chrono::steady_clock::now();
+        float delta = lastupdate.time_since_epoch().count() == 0 ? 1.0f / 60.0f : std::chrono::duration<float>(now - lastupdate).count();
+        lastupdate = now;
+
         if (globalcoords)
         {
-            this->entity->Translate(movementspeed / 60.0f, true);
+            this->entity->Translate(movementspeed * delta, true);
         }
         else
         {
-            this->entity->Move(movementspeed / 60.0f);
+            this->entity->Move(movementspeed * delta);
         }
-        this->entity->Turn(rotationspeed / 60.0f, globalcoords);
+        this->entity->Turn(rotationspeed * delta, globalcoords);
     }
 
     //This method will work with simple components
     virtual shared_ptr<Component> Copy()
     {
-        return std::make_shared<Mover>(*this);
+        // the copy is not known to the system of the original
+        auto copy = std::make_shared<Mover>(*this);
+        copy->batched = false;
+        return copy;
     }
 }; 
\ No newline at end of file
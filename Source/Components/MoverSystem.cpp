@@ -0,0 +1,505 @@
+#include "UltraEngine.h"
+#include "MoverSystem.h"
+#include "../Compute/Generated/EmbeddedShaders.h"
+#include <algorithm>
+#include <execution>
+#include <numeric>
+
+using namespace std;
+using namespace UltraEngine;
+
+// Push constants of Shaders/Compute/mover.comp
+struct MoverConstants
+{
+	uint32_t count;
+	float delta;
+	uint32_t slot;
+	// capacity of the snapshot arrays
+	uint32_t stride;
+};
+
+MoverSystem::MoverSystem(shared_ptr<World> world)
+{
+	_world = world;
+}
+
+shared_ptr<MoverSystem> MoverSystem::Create(shared_ptr<World> world)
+{
+	return make_shared<MoverSystem>(world);
+}
+
+uint32_t MoverSystem::Add(shared_ptr<Mover> mover)
+{
+	auto entity = mover->entity->Self()->As<Entity>();
+	uint32_t handle = Add(entity, mover->movementspeed, mover->rotationspeed, mover->globalcoords);
+	_components.back() = mover;
+	mover->batched = true;
+	return handle;
+}
+
+uint32_t MoverSystem::Add(shared_ptr<Entity> entity, const Vec3& movementspeed, const Vec3& rotationspeed, bool globalcoords)
+{
+	uint32_t handle;
+	if (!_freeHandles.empty())
+	{
+		handle = _freeHandles.back();
+		_freeHandles.pop_back();
+	}
+	else
+	{
+		handle = _indices.size();
+		_indices.push_back(INVALID_HANDLE);
+	}
+
+	size_t index = _entities.size();
+	_indices[handle] = index;
+	_handles.push_back(handle);
+	_entities.push_back(entity);
+	_components.push_back(weak_ptr<Mover>());
+
+	auto position = entity->GetPosition(false);
+	auto rotation = entity->GetQuaternion(false);
+	_arrays[MOVER_POSITION_X].push_back(position.x);
+	_arrays[MOVER_POSITION_Y].push_back(position.y);
+	_arrays[MOVER_POSITION_Z].push_back(position.z);
+	_arrays[MOVER_ROTATION_X].push_back(rotation.x);
+	_arrays[MOVER_ROTATION_Y].push_back(rotation.y);
+	_arrays[MOVER_ROTATION_Z].push_back(rotation.z);
+	_arrays[MOVER_ROTATION_W].push_back(rotation.w);
+	_arrays[MOVER_LOCAL].push_back(globalcoords ? 0.0f : 1.0f);
+	for (int array = MOVER_MOVEMENT_X; array <= MOVER_TURN_Z; array++)
+	{
+		_arrays[array].push_back(0.0f);
+	}
+	setSpeed(index, movementspeed, rotationspeed);
+
+	if (_state != nullptr)
+	{
+		_computeDirty.push_back(index);
+	}
+	return handle;
+}
+
+void MoverSystem::Remove(uint32_t handle)
+{
+	if (handle >= _indices.size() || _indices[handle] == INVALID_HANDLE)
+	{
+		return;
+	}
+
+	size_t index = _indices[handle];
+	auto component = _components[index].lock();
+	if (component != nullptr)
+	{
+		component->batched = false;
+		// the component was not updated while batched, its next own update integrates from now
+		component->lastupdate = std::chrono::steady_clock::now();
+	}
+
+	// the last mover takes the place of the removed one
+	size_t last = _entities.size() - 1;
+	for (auto& array : _arrays)
+	{
+		array[index] = array[last];
+		array.pop_back();
+	}
+	_entities[index] = _entities[last];
+	_entities.pop_back();
+	_components[index] = _components[last];
+	_components.pop_back();
+	_handles[index] = _handles[last];
+	_handles.pop_back();
+	if (index < _handles.size())
+	{
+		_indices[_handles[index]] = index;
+	}
+
+	_indices[handle] = INVALID_HANDLE;
+	_freeHandles.push_back(handle);
+
+	if (_state != nullptr)
+	{
+		// the GPU state follows the swap, the snapshots in flight replay it when they are read
+		_computeMoves.push_back({ uint32_t(index), uint32_t(last) });
+		if (index < last)
+		{
+			_computeDirty.push_back(index);
+		}
+	}
+}
+
+void MoverSystem::setSpeed(size_t index, const Vec3& movementspeed, const Vec3& rotationspeed)
+{
+	const float radians = 3.14159265f / 180.0f;
+	_arrays[MOVER_MOVEMENT_X][index] = movementspeed.x;
+	_arrays[MOVER_MOVEMENT_Y][index] = movementspeed.y;
+	_arrays[MOVER_MOVEMENT_Z][index] = movementspeed.z;
+	_arrays[MOVER_TURN_X][index] = rotationspeed.x * radians;
+	_arrays[MOVER_TURN_Y][index] = rotationspeed.y * radians;
+	_arrays[MOVER_TURN_Z][index] = rotationspeed.z * radians;
+}
+
+void MoverSystem::SetSpeed(uint32_t handle, const Vec3& movementspeed, const Vec3& rotationspeed)
+{
+	if (handle >= _indices.size() || _indices[handle] == INVALID_HANDLE)
+	{
+		return;
+	}
+
+	size_t index = _indices[handle];
+	setSpeed(index, movementspeed, rotationspeed);
+
+	// the shader only reads the speeds, so they are written straight into the GPU state. They are adjacent in the
+	// values of a mover, one write covers them.
+	if (_state != nullptr && index < _computeCapacity)
+	{
+		float speeds[MOVER_TURN_Z - MOVER_MOVEMENT_X + 1];
+		for (int array = MOVER_MOVEMENT_X; array <= MOVER_TURN_Z; array++)
+		{
+			speeds[array - MOVER_MOVEMENT_X] = _arrays[array][index];
+		}
+		_state->SetData(speeds, sizeof(speeds), (index * MOVER_ARRAY_COUNT + MOVER_MOVEMENT_X) * sizeof(float));
+	}
+}
+
+void MoverSystem::Update()
+{
+	auto now = std::chrono::steady_clock::now();
+	float delta = _started ? std::chrono::duration<float>(now - _lastUpdate).count() : 1.0f / 60.0f;
+	_lastUpdate = now;
+	_started = true;
+	Update(delta);
+}
+
+void MoverSystem::Update(float delta)
+{
+	if (_entities.empty())
+	{
+		return;
+	}
+
+	// without its pipeline the snapshots would only hold zeros, the movers stay on the CPU
+	if (_shader != nullptr && _shader->GetCompileState() == ComputeCompileState::FAILED)
+	{
+		_computeFailed = true;
+	}
+
+	auto world = _world.lock();
+	if (world != nullptr && !_computeFailed && _computeThreshold > 0 && _entities.size() >= _computeThreshold)
+	{
+		if (updateCompute(world, delta))
+		{
+			writeBack();
+		}
+		return;
+	}
+
+	if (_state != nullptr)
+	{
+		// back to the CPU, the arrays hold the last pose read from the GPU
+		releaseCompute();
+	}
+
+	updateCPU(delta);
+	writeBack();
+}
+
+void MoverSystem::integrate(size_t begin, size_t end, float delta)
+{
+	float* __restrict px = _arrays[MOVER_POSITION_X].data();
+	float* __restrict py = _arrays[MOVER_POSITION_Y].data();
+	float* __restrict pz = _arrays[MOVER_POSITION_Z].data();
+	float* __restrict qx = _arrays[MOVER_ROTATION_X].data();
+	float* __restrict qy = _arrays[MOVER_ROTATION_Y].data();
+	float* __restrict qz = _arrays[MOVER_ROTATION_Z].data();
+	float* __restrict qw = _arrays[MOVER_ROTATION_W].data();
+	const float* __restrict vx = _arrays[MOVER_MOVEMENT_X].data();
+	const float* __restrict vy = _arrays[MOVER_MOVEMENT_Y].data();
+	const float* __restrict vz = _arrays[MOVER_MOVEMENT_Z].data();
+	const float* __restrict wx = _arrays[MOVER_TURN_X].data();
+	const float* __restrict wy = _arrays[MOVER_TURN_Y].data();
+	const float* __restrict wz = _arrays[MOVER_TURN_Z].data();
+	const float* __restrict local = _arrays[MOVER_LOCAL].data();
+	float halfDelta = 0.5f * delta;
+
+	// no branches, local and global movers are blended by the local factor (keep in sync with mover.comp)
+	for (size_t i = begin; i < end; i++)
+	{
+		float x = qx[i], y = qy[i], z = qz[i], w = qw[i];
+
+		// movement rotated into the parent space: v + w * t + q x t with t = 2 * q x v
+		float mx = vx[i] * delta, my = vy[i] * delta, mz = vz[i] * delta;
+		float tx = 2.0f * (y * mz - z * my);
+		float ty = 2.0f * (z * mx - x * mz);
+		float tz = 2.0f * (x * my - y * mx);
+		float rx = mx + w * tx + (y * tz - z * ty);
+		float ry = my + w * ty + (z * tx - x * tz);
+		float rz = mz + w * tz + (x * ty - y * tx);
+		px[i] += mx + local[i] * (rx - mx);
+		py[i] += my + local[i] * (ry - my);
+		pz[i] += mz + local[i] * (rz - mz);
+
+		// q += delta / 2 * q * w for local turns and delta / 2 * w * q for global ones, which only flips the cross product
+		float ax = wx[i] * halfDelta, ay = wy[i] * halfDelta, az = wz[i] * halfDelta;
+		float side = 2.0f * local[i] - 1.0f;
+		float nx = x + w * ax + side * (y * az - z * ay);
+		float ny = y + w * ay + side * (z * ax - x * az);
+		float nz = z + w * az + side * (x * ay - y * ax);
+		float nw = w - (x * ax + y * ay + z * az);
+		float scale = 1.0f / std::sqrt(nx * nx + ny * ny + nz * nz + nw * nw);
+		qx[i] = nx * scale;
+		qy[i] = ny * scale;
+		qz[i] = nz * scale;
+		qw[i] = nw * scale;
+	}
+}
+
+void MoverSystem::updateCPU(float delta)
+{
+	size_t count = _entities.size();
+	size_t chunkCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	if (_chunks.size() != chunkCount)
+	{
+		_chunks.resize(chunkCount);
+		std::iota(_chunks.begin(), _chunks.end(), 0);
+	}
+
+	std::for_each(std::execution::par, _chunks.begin(), _chunks.end(), [this, count, delta](uint32_t chunk)
+		{
+			integrate(chunk * CHUNK_SIZE, std::min(count, (chunk + 1) * CHUNK_SIZE), delta);
+		});
+}
+
+void MoverSystem::packRecords(size_t begin, size_t end, float* records) const
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		for (int array = 0; array < MOVER_ARRAY_COUNT; array++)
+		{
+			records[(i - begin) * MOVER_ARRAY_COUNT + array] = _arrays[array][i];
+		}
+	}
+}
+
+void MoverSystem::reserveCompute()
+{
+	uint32_t count = _entities.size();
+	if (_state != nullptr && count <= _computeCapacity)
+	{
+		return;
+	}
+
+	uint32_t capacity = std::max(MIN_COMPUTE_CAPACITY, _computeCapacity);
+	while (capacity < count)
+	{
+		capacity *= 2;
+	}
+	_computeCapacity = capacity;
+
+	// the whole state, the poses are the last ones read back
+	vector<float> state(MOVER_ARRAY_COUNT * size_t(capacity), 0.0f);
+	packRecords(0, count, state.data());
+	_computeDirty.clear();
+
+	// the buffers in use are released by their destructors once the frames using them have completed, the snapshots in
+	// flight keep theirs. The descriptor sets of those frames must not change, so the shader is replaced along with the
+	// buffers, its pipeline comes from the cache.
+	_state = ComputeStorageBuffer::Create(state.size() * sizeof(float), state.data());
+	_snapshots = ComputeStorageBuffer::Create(SNAPSHOTS * MOVER_POSE_ARRAYS * size_t(capacity) * sizeof(float));
+
+	_shader = ComputeShader::CreateFromMemory(EmbeddedShaders::mover, sizeof(EmbeddedShaders::mover));
+	_shader->AddStorageBuffer(_state);
+	_shader->AddStorageBuffer(_snapshots);
+	_shader->SetupPushConstant(sizeof(MoverConstants));
+}
+
+void MoverSystem::uploadCompute()
+{
+	uint32_t count = _entities.size();
+	std::sort(_computeDirty.begin(), _computeDirty.end());
+	_computeDirty.erase(std::unique(_computeDirty.begin(), _computeDirty.end()), _computeDirty.end());
+
+	// one write per run of adjacent movers, the uploader sends them all with the frame's batch
+	vector<float> records;
+	size_t first = 0;
+	for (size_t i = 1; i <= _computeDirty.size(); i++)
+	{
+		if (i < _computeDirty.size() && _computeDirty[i] == _computeDirty[i - 1] + 1)
+		{
+			continue;
+		}
+
+		size_t begin = _computeDirty[first];
+		size_t end = std::min<size_t>(_computeDirty[i - 1] + 1, count);
+		first = i;
+		if (begin >= end)
+		{
+			continue;
+		}
+		records.resize((end - begin) * MOVER_ARRAY_COUNT);
+		packRecords(begin, end, records.data());
+		_state->SetData(records.data(), records.size() * sizeof(float), begin * MOVER_ARRAY_COUNT * sizeof(float));
+	}
+	_computeDirty.clear();
+}
+
+bool MoverSystem::readCompute()
+{
+	// the newest snapshot whose dispatch has completed, older completed ones are dropped
+	int newest = -1;
+	for (int slot = 0; slot < SNAPSHOTS; slot++)
+	{
+		auto& snapshot = _computeSnapshots[slot];
+		if (snapshot.completion != nullptr && snapshot.completion->IsComplete()
+			&& (newest < 0 || snapshot.update > _computeSnapshots[newest].update))
+		{
+			newest = slot;
+		}
+	}
+	if (newest < 0)
+	{
+		return false;
+	}
+
+	ComputeSnapshot snapshot = _computeSnapshots[newest];
+	for (auto& other : _computeSnapshots)
+	{
+		if (other.completion != nullptr && other.completion->IsComplete() && other.update <= snapshot.update)
+		{
+			other = ComputeSnapshot();
+		}
+	}
+
+	// the poses in the order of the dispatch, the removals since then bring them into the current order
+	size_t firstMove = snapshot.moves - _computeMoveBase;
+	size_t size = snapshot.count;
+	for (size_t i = firstMove; i < _computeMoves.size(); i++)
+	{
+		size = std::max<size_t>(size, _computeMoves[i].from + 1);
+	}
+
+	vector<float> poses(MOVER_POSE_ARRAYS * size);
+	vector<uint8_t> valid(size, 0);
+	std::fill(valid.begin(), valid.begin() + snapshot.count, 1);
+	for (int array = 0; array < MOVER_POSE_ARRAYS; array++)
+	{
+		snapshot.buffer->GetData(poses.data() + array * size, snapshot.count * sizeof(float), ((newest * MOVER_POSE_ARRAYS + array) * size_t(snapshot.capacity)) * sizeof(float));
+	}
+
+	for (size_t i = firstMove; i < _computeMoves.size(); i++)
+	{
+		auto& move = _computeMoves[i];
+		if (move.to != move.from)
+		{
+			for (int array = 0; array < MOVER_POSE_ARRAYS; array++)
+			{
+				poses[array * size + move.to] = poses[array * size + move.from];
+			}
+			valid[move.to] = valid[move.from];
+		}
+		valid[move.from] = 0;
+	}
+
+	// movers added after the dispatch keep their values
+	size_t count = std::min(size, _entities.size());
+	for (int array = 0; array < MOVER_POSE_ARRAYS; array++)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			if (valid[i])
+			{
+				_arrays[array][i] = poses[array * size + i];
+			}
+		}
+	}
+
+	// the moves older than every snapshot in flight are no longer needed
+	uint64_t oldest = _computeMoveBase + _computeMoves.size();
+	for (auto& pending : _computeSnapshots)
+	{
+		if (pending.completion != nullptr)
+		{
+			oldest = std::min(oldest, pending.moves);
+		}
+	}
+	_computeMoves.erase(_computeMoves.begin(), _computeMoves.begin() + (oldest - _computeMoveBase));
+	_computeMoveBase = oldest;
+	return true;
+}
+
+void MoverSystem::releaseCompute()
+{
+	_shader = nullptr;
+	_state = nullptr;
+	_snapshots = nullptr;
+	_computeCapacity = 0;
+	_computeDelta = 0.0f;
+	_computeDirty.clear();
+	for (auto& snapshot : _computeSnapshots)
+	{
+		snapshot = ComputeSnapshot();
+	}
+	_computeMoveBase += _computeMoves.size();
+	_computeMoves.clear();
+}
+
+bool MoverSystem::updateCompute(shared_ptr<World> world, float delta)
+{
+	bool read = readCompute();
+
+	uint32_t slot = _computeUpdates % SNAPSHOTS;
+	auto& snapshot = _computeSnapshots[slot];
+	if (snapshot.completion != nullptr)
+	{
+		// the GPU is SNAPSHOTS updates behind, the slot is still being written
+		_computeDelta += delta;
+		return read;
+	}
+
+	reserveCompute();
+	uploadCompute();
+
+	uint32_t count = _entities.size();
+	MoverConstants constants = {};
+	constants.count = count;
+	constants.delta = delta + _computeDelta;
+	constants.slot = slot;
+	constants.stride = _computeCapacity;
+	_computeDelta = 0.0f;
+
+	int tx, ty;
+	GetDispatchGrid((count + 255) / 256, tx, ty);
+	auto passes = ComputePassList::Create();
+	passes->Add(_shader, tx, ty, 1, &constants, sizeof(constants));
+
+	snapshot.completion = passes->BeginDispatch(world, ComputeHook::TRANSFER);
+	snapshot.buffer = _snapshots;
+	snapshot.capacity = _computeCapacity;
+	snapshot.count = count;
+	snapshot.update = _computeUpdates;
+	snapshot.moves = _computeMoveBase + _computeMoves.size();
+	_computeUpdates++;
+	return read;
+}
+
+void MoverSystem::writeBack()
+{
+	vector<uint32_t> expired;
+	for (size_t i = 0; i < _entities.size(); i++)
+	{
+		auto entity = _entities[i].lock();
+		if (entity == nullptr)
+		{
+			expired.push_back(_handles[i]);
+			continue;
+		}
+
+		entity->SetPosition(_arrays[MOVER_POSITION_X][i], _arrays[MOVER_POSITION_Y][i], _arrays[MOVER_POSITION_Z][i]);
+		entity->SetRotation(Quat(_arrays[MOVER_ROTATION_X][i], _arrays[MOVER_ROTATION_Y][i], _arrays[MOVER_ROTATION_Z][i], _arrays[MOVER_ROTATION_W][i]));
+	}
+
+	for (auto handle : expired)
+	{
+		Remove(handle);
+	}
+}
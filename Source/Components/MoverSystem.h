@@ -0,0 +1,143 @@
+#pragma once
+#include "UltraEngine.h"
+#include "Mover.hpp"
+#include "../Compute/ComputePass.h"
+#include "../Compute/ComputeStorageBuffer.h"
+#include <chrono>
+
+using namespace UltraEngine;
+using namespace UltraEngine::Compute;
+
+// Arrays of the MoverSystem state, the compute path stores the values of a mover in this order
+enum MoverArray
+{
+	MOVER_POSITION_X,
+	MOVER_POSITION_Y,
+	MOVER_POSITION_Z,
+	MOVER_ROTATION_X,
+	MOVER_ROTATION_Y,
+	MOVER_ROTATION_Z,
+	MOVER_ROTATION_W,
+	MOVER_MOVEMENT_X,
+	MOVER_MOVEMENT_Y,
+	MOVER_MOVEMENT_Z,
+	MOVER_TURN_X,
+	MOVER_TURN_Y,
+	MOVER_TURN_Z,
+	// 1 for local coordinates, 0 for global ones
+	MOVER_LOCAL,
+	MOVER_ARRAY_COUNT
+};
+
+// Position and rotation, the part of the state written back to the entities
+const int MOVER_POSE_ARRAYS = MOVER_ROTATION_W + 1;
+
+/// <summary>
+/// Moves and turns many entities in one pass instead of one Mover::Update call per entity.
+/// Positions, rotations and speeds are kept in one array per component, which the update walks in chunks spread over
+/// the worker threads, with loops the compiler vectorizes. The entities only receive the resulting position and rotation.
+/// Rotations are integrated as quaternions, which matches Entity::Turn for rotations around a single axis.
+/// The system owns the transforms of its entities: moving them elsewhere is overwritten by the next update.
+/// Positions are relative to the parent, so movers with globalcoords should not be parented.
+///
+/// From SetComputeThreshold movers on the integration runs in a compute shader instead. The entities then follow
+/// the GPU state with a latency of a few frames. Adding a mover uploads its values and removing one the values of the
+/// mover taking its place. The buffers grow by doubling, which uploads the whole state. Poses uploaded that way restart
+/// from the last ones read back.
+/// </summary>
+class MoverSystem : public Object
+{
+public:
+	// Poses in flight on the compute path. While all of them are pending, the time of further updates goes into the
+	// next dispatch.
+	static constexpr uint32_t SNAPSHOTS = ComputeContext::MAX_FRAMES_IN_FLIGHT + 2;
+
+private:
+	// Poses written by one compute update, read back once its dispatch has completed
+	struct ComputeSnapshot
+	{
+		shared_ptr<ComputeCompletion> completion;
+		// the buffer is replaced when the capacity grows, a snapshot keeps the one it was written to
+		shared_ptr<ComputeStorageBuffer> buffer;
+		uint32_t capacity = 0;
+		uint32_t count = 0;
+		uint64_t update = 0;
+		// removals done before the dispatch, see _computeMoves
+		uint64_t moves = 0;
+	};
+
+	// A removal: the mover at from, the last one, takes the place of the removed one at to
+	struct ComputeMove
+	{
+		uint32_t to;
+		uint32_t from;
+	};
+
+	vector<float> _arrays[MOVER_ARRAY_COUNT];
+	vector<weak_ptr<Entity>> _entities;
+	// component of each mover, if it was added as one
+	vector<weak_ptr<Mover>> _components;
+	// handles stay valid while the movers are swapped around by removals
+	vector<uint32_t> _handles;
+	vector<uint32_t> _indices;
+	vector<uint32_t> _freeHandles;
+	vector<uint32_t> _chunks;
+
+	std::chrono::steady_clock::time_point _lastUpdate;
+	bool _started = false;
+
+	weak_ptr<World> _world;
+	uint32_t _computeThreshold = 0;
+	bool _computeFailed = false;
+	shared_ptr<ComputeShader> _shader;
+	shared_ptr<ComputeStorageBuffer> _state;
+	shared_ptr<ComputeStorageBuffer> _snapshots;
+	// movers the buffers have room for
+	uint32_t _computeCapacity = 0;
+	uint64_t _computeUpdates = 0;
+	// time of updates skipped while the GPU was behind, integrated by the next dispatch
+	float _computeDelta = 0.0f;
+	// movers whose values have to be uploaded before the next dispatch
+	vector<uint32_t> _computeDirty;
+	ComputeSnapshot _computeSnapshots[SNAPSHOTS];
+	// removals since the oldest snapshot in flight, replayed on its poses when it is read back.
+	// _computeMoveBase counts the ones dropped from the front.
+	vector<ComputeMove> _computeMoves;
+	uint64_t _computeMoveBase = 0;
+
+	void integrate(size_t begin, size_t end, float delta);
+	void updateCPU(float delta);
+	bool updateCompute(shared_ptr<World> world, float delta);
+	void reserveCompute();
+	void uploadCompute();
+	bool readCompute();
+	void releaseCompute();
+	// Interleaves the values of the movers in [begin, end), MOVER_ARRAY_COUNT floats per mover
+	void packRecords(size_t begin, size_t end, float* records) const;
+	void writeBack();
+	void setSpeed(size_t index, const Vec3& movementspeed, const Vec3& rotationspeed);
+
+public:
+	static constexpr size_t CHUNK_SIZE = 4096;
+	// Minimum capacity of the compute buffers
+	static constexpr uint32_t MIN_COMPUTE_CAPACITY = 1024;
+	static constexpr uint32_t INVALID_HANDLE = 0xffffffff;
+
+	MoverSystem(shared_ptr<World> world);
+	static shared_ptr<MoverSystem> Create(shared_ptr<World> world);
+
+	// Takes over the entity of the component, Mover::Update does nothing until the mover is removed again
+	uint32_t Add(shared_ptr<Mover> mover);
+	uint32_t Add(shared_ptr<Entity> entity, const Vec3& movementspeed, const Vec3& rotationspeed, bool globalcoords = false);
+	void Remove(uint32_t handle);
+	// Speeds are given per second, the rotation speed in degrees
+	void SetSpeed(uint32_t handle, const Vec3& movementspeed, const Vec3& rotationspeed);
+	size_t CountMovers() const { return _entities.size(); }
+
+	// Number of movers from which the compute shader path is used, 0 keeps the update on the CPU
+	void SetComputeThreshold(uint32_t count) { _computeThreshold = count; }
+
+	// Call once per frame, uses the time since the last call. Movers whose entity was deleted are removed.
+	void Update();
+	void Update(float delta);
+};
@@ -0,0 +1,276 @@
+#include "UltraEngine.h"
+#include "ComputeBenchmark.h"
+#include "ComputePrimitives.h"
+#include "ComputeSort.h"
+#include "Generated/EmbeddedShaders.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <random>
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	// Renders until the frame of the last dispatch has completed on the GPU
+	static void waitForCompute(shared_ptr<World> world, shared_ptr<Framebuffer> framebuffer)
+	{
+		uint64_t frame = ComputeContext::Get()->GetFrame();
+		while (ComputeContext::Get()->GetFrame() < frame + ComputeContext::MAX_FRAMES_IN_FLIGHT + 1)
+		{
+			world->Update();
+			world->Render(framebuffer);
+		}
+	}
+
+	static double getGpuMilliseconds(shared_ptr<ComputePassList> passes)
+	{
+		auto timer = passes->GetQueryTimer();
+		auto timestamps = timer->GetQueryPoolResults();
+		return double(timestamps[1] - timestamps[0]) * timer->GetPeriod() / 1e6;
+	}
+
+	template <typename Function>
+	static double getCpuMilliseconds(Function function)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		function();
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+
+	static void printHeader(const char* name, const char* unit)
+	{
+		char line[128];
+		snprintf(line, sizeof(line), "%-10s%12s%12s%12s%12s%12s", name, unit, "gpu ms", "gpu M/s", "cpu ms", "cpu M/s");
+		Print(line);
+	}
+
+	static void printResult(const char* name, uint32_t count, double gpuMs, double cpuMs, bool match)
+	{
+		char line[128];
+		snprintf(line, sizeof(line), "%-10s%12u%12.3f%12.3f%12.3f%12.3f    %s", name, count,
+			gpuMs, gpuMs > 0.0 ? count / gpuMs / 1e3 : 0.0,
+			cpuMs, cpuMs > 0.0 ? count / cpuMs / 1e3 : 0.0,
+			match ? "ok" : "MISMATCH");
+		Print(line);
+	}
+
+	void RunPrimitiveBenchmarks(shared_ptr<World> world, shared_ptr<Framebuffer> framebuffer)
+	{
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device->physicaldevice, &properties);
+
+		printHeader("primitive", "elements");
+
+		std::mt19937 random(1);
+		for (uint32_t count : { 1u << 16, 1u << 20, 1u << 24, 1u << 27 })
+		{
+			if (uint64_t(count) * sizeof(uint32_t) > properties.limits.maxStorageBufferRange)
+			{
+				Print(std::to_string(count) + " elements exceed maxStorageBufferRange, skipped");
+				continue;
+			}
+
+			vector<uint32_t> data(count);
+			for (auto& value : data)
+			{
+				value = random() & 0xff;
+			}
+
+			auto input = ComputeStorageBuffer::Create(count * sizeof(uint32_t), data.data());
+			auto output = ComputeStorageBuffer::Create(count * sizeof(uint32_t));
+			vector<uint32_t> expected(count);
+			vector<uint32_t> result(count);
+
+			// the first dispatch of each primitive also builds its pipeline, the second one is measured
+			auto scan = ComputeScan::Create(input, output, count);
+			for (int run = 0; run < 2; run++)
+			{
+				scan->Dispatch(world, count, true);
+				waitForCompute(world, framebuffer);
+			}
+			double cpuMs = getCpuMilliseconds([&]() { std::inclusive_scan(data.begin(), data.end(), expected.begin()); });
+			output->GetData(result.data(), count * sizeof(uint32_t));
+			printResult("scan", count, getGpuMilliseconds(scan->GetLastPasses()), cpuMs, result == expected);
+
+			auto reduce = ComputeReduce::Create(input, count, ComputeDataType::UINT, ComputeReduceOp::SUM);
+			for (int run = 0; run < 2; run++)
+			{
+				reduce->Dispatch(world, count);
+				waitForCompute(world, framebuffer);
+			}
+			uint32_t sum = 0;
+			cpuMs = getCpuMilliseconds([&]() { sum = std::reduce(data.begin(), data.end(), 0u); });
+			printResult("reduce", count, getGpuMilliseconds(reduce->GetLastPasses()), cpuMs, reduce->GetResult<uint32_t>() == sum);
+
+			auto compact = ComputeCompact::Create(input, output, count);
+			for (int run = 0; run < 2; run++)
+			{
+				compact->Dispatch(world, count, ComputePredicate::LESS, 64u);
+				waitForCompute(world, framebuffer);
+			}
+			size_t selected = 0;
+			cpuMs = getCpuMilliseconds([&]() { selected = std::copy_if(data.begin(), data.end(), expected.begin(), [](uint32_t value) { return value < 64; }) - expected.begin(); });
+			bool match = compact->GetCount() == selected;
+			if (match)
+			{
+				output->GetData(result.data(), selected * sizeof(uint32_t));
+				match = std::equal(expected.begin(), expected.begin() + selected, result.begin());
+			}
+			printResult("compact", count, getGpuMilliseconds(compact->GetLastPasses()), cpuMs, match);
+		}
+	}
+
+	void RunSortBenchmarks(shared_ptr<World> world, shared_ptr<Framebuffer> framebuffer)
+	{
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device->physicaldevice, &properties);
+
+		printHeader("sort", "keys");
+
+		std::mt19937 random(1);
+		for (uint32_t count : { 10000u, 100000u, 1000000u, 10000000u, 100000000u })
+		{
+			if (uint64_t(count) * sizeof(uint32_t) > properties.limits.maxStorageBufferRange)
+			{
+				Print(std::to_string(count) + " keys exceed maxStorageBufferRange, skipped");
+				continue;
+			}
+
+			vector<uint32_t> keys(count);
+			vector<uint32_t> indices(count);
+			for (uint32_t n = 0; n < count; n++)
+			{
+				keys[n] = random();
+				indices[n] = n;
+			}
+
+			vector<uint32_t> expected = keys;
+			double cpuMs = getCpuMilliseconds([&]() { std::sort(expected.begin(), expected.end()); });
+
+			// keys only
+			auto keyBuffer = ComputeStorageBuffer::Create(count * sizeof(uint32_t), keys.data());
+			auto sort = ComputeSort::Create(keyBuffer, nullptr, count);
+			vector<uint32_t> result(count);
+			for (int run = 0; run < 2; run++)
+			{
+				// the first run sorted the buffer already
+				keyBuffer->SetData(keys.data(), count * sizeof(uint32_t));
+				sort->Dispatch(world, count);
+				waitForCompute(world, framebuffer);
+			}
+			keyBuffer->GetData(result.data(), count * sizeof(uint32_t));
+			printResult("keys", count, getGpuMilliseconds(sort->GetLastPasses()), cpuMs, result == expected);
+			sort = nullptr;
+			keyBuffer = nullptr;
+
+			// keys with their original index as value, the stable CPU sort is the fair comparison
+			vector<std::pair<uint32_t, uint32_t>> pairs(count);
+			for (uint32_t n = 0; n < count; n++)
+			{
+				pairs[n] = { keys[n], n };
+			}
+			cpuMs = getCpuMilliseconds([&]() { std::stable_sort(pairs.begin(), pairs.end(), [](const auto& a, const auto& b) { return a.first < b.first; }); });
+
+			keyBuffer = ComputeStorageBuffer::Create(count * sizeof(uint32_t), keys.data());
+			auto valueBuffer = ComputeStorageBuffer::Create(count * sizeof(uint32_t), indices.data());
+			sort = ComputeSort::Create(keyBuffer, valueBuffer, count);
+			for (int run = 0; run < 2; run++)
+			{
+				keyBuffer->SetData(keys.data(), count * sizeof(uint32_t));
+				valueBuffer->SetData(indices.data(), count * sizeof(uint32_t));
+				sort->Dispatch(world, count);
+				waitForCompute(world, framebuffer);
+			}
+			keyBuffer->GetData(result.data(), count * sizeof(uint32_t));
+			valueBuffer->GetData(indices.data(), count * sizeof(uint32_t));
+			bool match = true;
+			for (uint32_t n = 0; n < count && match; n++)
+			{
+				match = result[n] == pairs[n].first && indices[n] == pairs[n].second;
+			}
+			printResult("pairs", count, getGpuMilliseconds(sort->GetLastPasses()), cpuMs, match);
+		}
+	}
+	struct BufferReferenceEntry
+	{
+		VkDeviceAddress values;
+		uint32_t count;
+		uint32_t padding;
+	};
+
+	struct BufferReferenceConstants
+	{
+		VkDeviceAddress table;
+		uint32_t entryCount;
+		uint32_t count;
+	};
+
+	void RunBufferReferenceBenchmarks(shared_ptr<World> world, shared_ptr<Framebuffer> framebuffer)
+	{
+		if (!ComputeStorageBuffer::HasDeviceAddresses())
+		{
+			Print("buffer_reference skipped, device addresses are not enabled (ComputeStorageBuffer::EnableDeviceAddresses)");
+			return;
+		}
+
+		printHeader("gather", "elements");
+
+		const uint32_t bufferCount = 8;
+		std::mt19937 random(1);
+		for (uint32_t count : { 1u << 16, 1u << 20, 1u << 22 })
+		{
+			// the value buffers are only reachable through the table, none of them is bound to the shader
+			vector<vector<uint32_t>> data(bufferCount);
+			vector<shared_ptr<ComputeStorageBuffer>> buffers;
+			vector<BufferReferenceEntry> entries;
+			for (uint32_t n = 0; n < bufferCount; n++)
+			{
+				// buffers of different lengths, the kernel checks each count
+				uint32_t length = count - n * (count / 16);
+				data[n].resize(length);
+				for (auto& value : data[n])
+				{
+					value = random() & 0xff;
+				}
+				buffers.push_back(ComputeStorageBuffer::Create(length * sizeof(uint32_t), data[n].data()));
+				entries.push_back({ buffers.back()->GetDeviceAddress(), length, 0 });
+			}
+			auto table = ComputeStorageBuffer::Create(entries.size() * sizeof(BufferReferenceEntry), entries.data());
+			auto sums = ComputeStorageBuffer::Create(count * sizeof(uint32_t));
+
+			auto shader = ComputeShader::CreateFromMemory(EmbeddedShaders::buffer_reference_sum, sizeof(EmbeddedShaders::buffer_reference_sum));
+			shader->AddStorageBuffer(sums);
+			shader->SetupPushConstant(sizeof(BufferReferenceConstants));
+
+			BufferReferenceConstants constants = { table->GetDeviceAddress(), bufferCount, count };
+			for (int run = 0; run < 2; run++)
+			{
+				shader->BeginDispatch(world, (count + 255) / 256, 1, 1, true, ComputeHook::TRANSFER, &constants, sizeof(BufferReferenceConstants));
+				waitForCompute(world, framebuffer);
+			}
+
+			vector<uint32_t> expected(count, 0);
+			double cpuMs = getCpuMilliseconds([&]()
+				{
+					for (auto& values : data)
+					{
+						for (size_t i = 0; i < values.size(); i++)
+						{
+							expected[i] += values[i];
+						}
+					}
+				});
+			vector<uint32_t> result(count);
+			sums->GetData(result.data(), count * sizeof(uint32_t));
+
+			auto timer = shader->GetQueryTimer();
+			auto timestamps = timer->GetQueryPoolResults();
+			double gpuMs = double(timestamps[1] - timestamps[0]) * timer->GetPeriod() / 1e6;
+			printResult("gather", count, gpuMs, cpuMs, result == expected);
+		}
+	}
+}
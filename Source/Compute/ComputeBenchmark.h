@@ -0,0 +1,16 @@
+#pragma once
+#include "UltraEngine.h"
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	// Runs the compute primitives against their CPU counterparts (std::inclusive_scan, std::reduce, std::copy_if) for
+	// growing element counts and prints timings and throughput to the console. Renders frames until each dispatch completed.
+	void RunPrimitiveBenchmarks(shared_ptr<World> world, shared_ptr<Framebuffer> framebuffer);
+	// Sorts 10K to 100M random keys, with and without values, and compares the throughput with std::sort / std::stable_sort
+	void RunSortBenchmarks(shared_ptr<World> world, shared_ptr<Framebuffer> framebuffer);
+	// Sums 8 buffers element by element with a kernel which reaches them through their device addresses
+	// (Shaders/Compute/buffer_reference_sum.comp). Skipped unless ComputeStorageBuffer::EnableDeviceAddresses was called.
+	void RunBufferReferenceBenchmarks(shared_ptr<World> world, shared_ptr<Framebuffer> framebuffer);
+}
@@ -0,0 +1,290 @@
+#include "UltraEngine.h"
+#include "ComputeBindlessHeap.h"
+#include "ComputeShader.h"
+#include "ComputeMemoryStats.h"
+#include <atomic>
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	static std::atomic<bool> Enabled = false;
+
+	ComputeBindlessHeap::ComputeBindlessHeap()
+	{
+		_capacity[int(ComputeBindlessType::STORAGE_IMAGE)] = MAX_STORAGE_IMAGES;
+		_capacity[int(ComputeBindlessType::SAMPLED_IMAGE)] = MAX_SAMPLED_IMAGES;
+		_capacity[int(ComputeBindlessType::STORAGE_BUFFER)] = MAX_STORAGE_BUFFERS;
+
+		// stay within the update-after-bind limits of the device
+		VkPhysicalDevice physicalDevice = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device->physicaldevice;
+
+		VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+		indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &indexingProperties;
+		vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+		_capacity[int(ComputeBindlessType::STORAGE_IMAGE)] = std::min(MAX_STORAGE_IMAGES, indexingProperties.maxDescriptorSetUpdateAfterBindStorageImages);
+		_capacity[int(ComputeBindlessType::SAMPLED_IMAGE)] = std::min(MAX_SAMPLED_IMAGES, indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages);
+		_capacity[int(ComputeBindlessType::STORAGE_BUFFER)] = std::min(MAX_STORAGE_BUFFERS, indexingProperties.maxDescriptorSetUpdateAfterBindStorageBuffers);
+	}
+
+	shared_ptr<ComputeBindlessHeap> ComputeBindlessHeap::Get()
+	{
+		static shared_ptr<ComputeBindlessHeap> heap = make_shared<ComputeBindlessHeap>();
+		return heap;
+	}
+
+	bool ComputeBindlessHeap::IsSupported()
+	{
+		VkPhysicalDevice physicalDevice = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device->physicaldevice;
+
+		VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+		VkPhysicalDeviceFeatures2 features{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &indexingFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+		return indexingFeatures.runtimeDescriptorArray
+			&& indexingFeatures.descriptorBindingPartiallyBound
+			&& indexingFeatures.descriptorBindingStorageImageUpdateAfterBind
+			&& indexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+			&& indexingFeatures.descriptorBindingStorageBufferUpdateAfterBind
+			&& indexingFeatures.descriptorBindingUpdateUnusedWhilePending;
+	}
+
+	bool ComputeBindlessHeap::Enable(bool enable)
+	{
+		if (enable && !IsSupported())
+		{
+			Print("Error: The device does not support the descriptor indexing features of ComputeBindlessHeap");
+			Enabled = false;
+			return false;
+		}
+		Enabled = enable;
+		return true;
+	}
+
+	bool ComputeBindlessHeap::IsEnabled()
+	{
+		return Enabled;
+	}
+
+	uint32_t ComputeBindlessHeap::allocate(ComputeBindlessType type)
+	{
+		auto& slots = _slots[int(type)];
+		auto& freeIndices = _freeIndices[int(type)];
+
+		uint32_t index;
+		if (!freeIndices.empty())
+		{
+			index = freeIndices.back();
+			freeIndices.pop_back();
+		}
+		else if (slots.size() < _capacity[int(type)])
+		{
+			index = slots.size();
+			slots.push_back({});
+		}
+		else
+		{
+			Print("Error: ComputeBindlessHeap is full, " + std::to_string(_capacity[int(type)]) + " descriptors of this type are in use");
+			return INVALID_INDEX;
+		}
+
+		slots[index].used = true;
+		_pendingWrites.push_back({ type, index });
+		return index;
+	}
+
+	uint32_t ComputeBindlessHeap::addImage(ComputeBindlessType type, shared_ptr<Texture> texture, int miplevel)
+	{
+		auto data = make_shared<ComputeBufferData>();
+		data->Texture = texture;
+		data->mipLevel = miplevel;
+		data->IsWrite = type == ComputeBindlessType::STORAGE_IMAGE;
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		uint32_t index = allocate(type);
+		if (index != INVALID_INDEX)
+		{
+			_slots[int(type)][index].image = data;
+		}
+		return index;
+	}
+
+	uint32_t ComputeBindlessHeap::AddStorageImage(shared_ptr<Texture> texture, int miplevel)
+	{
+		return addImage(ComputeBindlessType::STORAGE_IMAGE, texture, miplevel);
+	}
+
+	uint32_t ComputeBindlessHeap::AddSampledImage(shared_ptr<Texture> texture)
+	{
+		return addImage(ComputeBindlessType::SAMPLED_IMAGE, texture, 0);
+	}
+
+	uint32_t ComputeBindlessHeap::AddStorageBuffer(const ComputeBuffer& buffer)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		uint32_t index = allocate(ComputeBindlessType::STORAGE_BUFFER);
+		if (index != INVALID_INDEX)
+		{
+			_slots[int(ComputeBindlessType::STORAGE_BUFFER)][index].buffer = buffer.descriptor;
+		}
+		return index;
+	}
+
+	void ComputeBindlessHeap::Remove(ComputeBindlessType type, uint32_t index)
+	{
+		shared_ptr<ComputeBufferData> image;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			// a second Remove would put the index on the free list twice and two later registrations would share it
+			if (index >= _slots[int(type)].size() || !_slots[int(type)][index].used)
+			{
+				Print("Error: ComputeBindlessHeap::Remove called for index " + std::to_string(index) + ", which is not registered");
+				return;
+			}
+			auto& slot = _slots[int(type)][index];
+			image = slot.image;
+			slot.image = nullptr;
+			slot.used = false;
+		}
+
+		// the descriptor is left in place, partially bound descriptors are never accessed once the index is unused.
+		// The view of an image is retired by its binding data.
+		auto heap = Self()->As<ComputeBindlessHeap>();
+		ComputeContext::Get()->Retire([heap, type, index](VkDevice device)
+			{
+				std::lock_guard<std::mutex> lock(heap->_mutex);
+				heap->_freeIndices[int(type)].push_back(index);
+			});
+	}
+
+	void ComputeBindlessHeap::init(VkDevice device)
+	{
+		VkDescriptorType types[3] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
+
+		VkDescriptorSetLayoutBinding bindings[3];
+		VkDescriptorBindingFlags bindingFlags[3];
+		VkDescriptorPoolSize poolSizes[3];
+		for (int i = 0; i < 3; i++)
+		{
+			bindings[i] = initializers::descriptorSetLayoutBinding(types[i], VK_SHADER_STAGE_COMPUTE_BIT, i, _capacity[i]);
+			// slots are written while frames using other slots of the set are still in flight
+			bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+			poolSizes[i] = initializers::descriptorPoolSize(types[i], _capacity[i]);
+		}
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+		bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsInfo.bindingCount = 3;
+		bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo = initializers::descriptorSetLayoutCreateInfo(bindings, 3);
+		layoutInfo.pNext = &bindingFlagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &_setLayout));
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.pPoolSizes = poolSizes;
+		poolInfo.poolSizeCount = 3;
+		poolInfo.maxSets = 1;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &poolInfo, nullptr, &_descriptorPool));
+		{
+			ComputeMemoryScope scope("ComputeBindlessHeap");
+			ComputeMemoryStats::Get()->Track((uint64_t)_descriptorPool, ComputeResourceType::DESCRIPTOR_POOL);
+		}
+
+		VkDescriptorSetAllocateInfo allocInfo = initializers::descriptorSetAllocateInfo(_descriptorPool, &_setLayout, 1);
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &_descriptorSet));
+	}
+
+	VkDescriptorSetLayout ComputeBindlessHeap::GetLayout(VkDevice device)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_setLayout == VK_NULL_HANDLE)
+		{
+			init(device);
+		}
+		return _setLayout;
+	}
+
+	VkDescriptorSet ComputeBindlessHeap::Flush(VkDevice device, VkCommandBuffer commandBuffer)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_setLayout == VK_NULL_HANDLE)
+		{
+			init(device);
+		}
+
+		if (_pendingWrites.empty())
+		{
+			return _descriptorSet;
+		}
+
+		vector<VkWriteDescriptorSet> writes;
+		vector<VkDescriptorImageInfo> imageInfos;
+		writes.reserve(_pendingWrites.size());
+		// the writes point into imageInfos, it must not reallocate
+		imageInfos.reserve(_pendingWrites.size());
+
+		for (auto& pending : _pendingWrites)
+		{
+			auto& slot = _slots[int(pending.type)][pending.index];
+			if (!slot.used)
+			{
+				// removed before it was ever written
+				continue;
+			}
+
+			switch (pending.type)
+			{
+			case ComputeBindlessType::STORAGE_IMAGE:
+			case ComputeBindlessType::SAMPLED_IMAGE:
+			{
+				slot.image->createImageView(device, slot.image->Texture);
+				if (pending.type == ComputeBindlessType::STORAGE_IMAGE)
+				{
+					// storage textures stay in the general layout, like the mip arrays they are synchronized in place so
+					// registering a texture keeps its content
+					uint32_t baseLayer, layerCount;
+					slot.image->getLayerRange(baseLayer, layerCount);
+					tools::insertImageMemoryBarrier(commandBuffer, slot.image->Texture->GetImage(),
+						VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT,
+						VK_IMAGE_LAYOUT_GENERAL,
+						VK_IMAGE_LAYOUT_GENERAL,
+						VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+						VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						{ VK_IMAGE_ASPECT_COLOR_BIT, (uint32_t)slot.image->mipLevel, 1, baseLayer, layerCount });
+				}
+				VkSampler sampler = pending.type == ComputeBindlessType::SAMPLED_IMAGE ? slot.image->Texture->GetSampler() : VK_NULL_HANDLE;
+				imageInfos.push_back(initializers::descriptorImageInfo(sampler, slot.image->mipmapImage, VK_IMAGE_LAYOUT_GENERAL));
+
+				VkDescriptorType type = pending.type == ComputeBindlessType::STORAGE_IMAGE ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				auto write = initializers::writeDescriptorSet(_descriptorSet, type, int(pending.type), &imageInfos.back());
+				write.dstArrayElement = pending.index;
+				writes.push_back(write);
+				break;
+			}
+			case ComputeBindlessType::STORAGE_BUFFER:
+			{
+				auto write = initializers::writeDescriptorSet(_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, int(pending.type), &slot.buffer);
+				write.dstArrayElement = pending.index;
+				writes.push_back(write);
+				break;
+			}
+			}
+		}
+		_pendingWrites.clear();
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, NULL);
+		return _descriptorSet;
+	}
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include "UltraEngine.h"
+#include "VulkanUtils.h"
+#include "ComputeContext.h"
+#include <mutex>
+
+using namespace UltraEngine;
+using namespace UltraEngine::Compute::Utils;
+
+namespace UltraEngine::Compute
+{
+	class ComputeBufferData;
+
+	enum class ComputeBindlessType
+	{
+		STORAGE_IMAGE = 0,
+		SAMPLED_IMAGE = 1,
+		STORAGE_BUFFER = 2
+	};
+
+	/// <summary>
+	/// Global descriptor heap for bindless compute shaders (Shaders/Compute/bindless.glsl).
+	/// Textures and buffers are registered once and addressed by the returned index, which shaders receive through
+	/// push constants. The heap is a single update-after-bind descriptor set shared by every bindless shader, so the
+	/// binding cost does not depend on the number of resources.
+	/// Needs the descriptor indexing features (Vulkan 1.2) enabled on the engine's device, confirmed with Enable(true).
+	/// </summary>
+	class ComputeBindlessHeap : public Object
+	{
+	public:
+		static constexpr uint32_t MAX_STORAGE_IMAGES = 1024;
+		static constexpr uint32_t MAX_SAMPLED_IMAGES = 4096;
+		static constexpr uint32_t MAX_STORAGE_BUFFERS = 1024;
+		static constexpr uint32_t INVALID_INDEX = 0xffffffff;
+
+	private:
+		struct Slot
+		{
+			shared_ptr<ComputeBufferData> image;
+			VkDescriptorBufferInfo buffer;
+			bool used = false;
+		};
+
+		struct PendingWrite
+		{
+			ComputeBindlessType type;
+			uint32_t index;
+		};
+
+		std::mutex _mutex;
+		vector<Slot> _slots[3];
+		vector<uint32_t> _freeIndices[3];
+		uint32_t _capacity[3];
+		vector<PendingWrite> _pendingWrites;
+
+		VkDescriptorSetLayout _setLayout = VK_NULL_HANDLE;
+		VkDescriptorPool _descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSet _descriptorSet = VK_NULL_HANDLE;
+
+		uint32_t allocate(ComputeBindlessType type);
+		uint32_t addImage(ComputeBindlessType type, shared_ptr<Texture> texture, int miplevel);
+		void init(VkDevice device);
+
+	public:
+		ComputeBindlessHeap();
+		static shared_ptr<ComputeBindlessHeap> Get();
+
+		// Returns if the physical device has the descriptor indexing features the heap depends on. That alone does not
+		// make them usable, the features also have to be enabled on the logical device, see Enable.
+		static bool IsSupported();
+		// Whether the engine enabled the descriptor indexing features on its device can not be queried, so bindless
+		// shaders are rejected until the application confirmed it with Enable(true). Returns false, and stays disabled,
+		// if the physical device does not support the features.
+		static bool Enable(bool enable);
+		static bool IsEnabled();
+
+		// A single mip level as storage image, binding 0 of the heap
+		uint32_t AddStorageImage(shared_ptr<Texture> texture, int miplevel = 0);
+		// The whole texture with its sampler, binding 1 of the heap
+		uint32_t AddSampledImage(shared_ptr<Texture> texture);
+		// The buffer must outlive its registration, binding 2 of the heap
+		uint32_t AddStorageBuffer(const ComputeBuffer& buffer);
+		// The index is reused once the frames which may still access it have completed. Each index is removed once.
+		void Remove(ComputeBindlessType type, uint32_t index);
+
+		// Rendering thread only
+		VkDescriptorSetLayout GetLayout(VkDevice device);
+		// Writes the descriptors registered since the last call and returns the heap's descriptor set.
+		// New storage images are synchronized in the general layout, their content is kept.
+		VkDescriptorSet Flush(VkDevice device, VkCommandBuffer commandBuffer);
+	};
+}
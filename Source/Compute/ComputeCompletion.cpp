@@ -0,0 +1,77 @@
+#include "UltraEngine.h"
+#include "ComputeCompletion.h"
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	ComputeCompletion::ComputeCompletion()
+	{
+		_future = _promise.get_future().share();
+	}
+
+	shared_ptr<ComputeCompletion> ComputeCompletion::Create()
+	{
+		return make_shared<ComputeCompletion>();
+	}
+
+	void ComputeCompletion::Wait()
+	{
+		_future.wait();
+	}
+
+	void ComputeCompletion::Then(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (!_complete)
+			{
+				_continuations.push_back(std::move(task));
+				return;
+			}
+		}
+		ComputeContext::Get()->Post(std::move(task));
+	}
+
+	void ComputeCompletion::Signal()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_recorded)
+			{
+				return;
+			}
+			_recorded = true;
+		}
+
+		// completes with the resources retired in this frame
+		auto completion = Self()->As<ComputeCompletion>();
+		ComputeContext::Get()->Retire([completion](VkDevice device)
+			{
+				completion->Complete();
+			});
+	}
+
+	void ComputeCompletion::Complete()
+	{
+		vector<std::function<void()>> continuations;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_complete)
+			{
+				return;
+			}
+			_recorded = true;
+			_complete = true;
+			std::swap(continuations, _continuations);
+		}
+
+		_promise.set_value();
+		auto context = ComputeContext::Get();
+		for (auto& task : continuations)
+		{
+			context->Post(std::move(task));
+		}
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "UltraEngine.h"
+#include "ComputeContext.h"
+#include <atomic>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <coroutine>
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	/// <summary>
+	/// Completes once the GPU has executed the work it was handed to. The engine submits the command buffers, so instead
+	/// of a fence of its own the handle follows the frames: work recorded in frame N has completed when frame
+	/// N + ComputeContext::MAX_FRAMES_IN_FLIGHT begins, the same rule which releases retired resources.
+	///
+	/// The result can be polled, waited for through a future on a worker thread, or handled by continuations which
+	/// ComputeContext::Pump runs on the game thread. A coroutine returning ComputeTask can await the handle:
+	///   ComputeTask Simulate(shared_ptr<World> world)
+	///   {
+	///       co_await shader->BeginDispatch(world, 64, 64, 1);
+	///       buffer->GetData(...);   // resumed by ComputeContext::Pump once the dispatch has completed
+	///   }
+	/// </summary>
+	class ComputeCompletion : public Object
+	{
+	private:
+		std::mutex _mutex;
+		std::atomic<bool> _complete = false;
+		bool _recorded = false;
+		std::promise<void> _promise;
+		std::shared_future<void> _future;
+		vector<std::function<void()>> _continuations;
+
+	public:
+		ComputeCompletion();
+		static shared_ptr<ComputeCompletion> Create();
+
+		bool IsComplete() const { return _complete; }
+		// Blocks until completion. The rendering thread completes the handle, so never wait on it, and waiting on the
+		// game thread stalls the frames which would complete it: use continuations there instead.
+		void Wait();
+		std::shared_future<void> GetFuture() const { return _future; }
+		// Runs the task in the first ComputeContext::Pump after completion
+		void Then(std::function<void()> task);
+
+		// Called on the rendering thread once the work has been recorded into the frame's command buffer, further calls
+		// are ignored. Work spread over several frames calls it after recording its last part.
+		void Signal();
+		// Completes right away, e.g. for work which turned out to be empty
+		void Complete();
+
+		struct Awaiter
+		{
+			shared_ptr<ComputeCompletion> completion;
+
+			bool await_ready() const { return completion == nullptr || completion->IsComplete(); }
+			void await_suspend(std::coroutine_handle<> handle) { completion->Then([handle]() { handle.resume(); }); }
+			void await_resume() const {}
+		};
+	};
+
+	inline ComputeCompletion::Awaiter operator co_await(shared_ptr<ComputeCompletion> completion)
+	{
+		return ComputeCompletion::Awaiter{ completion };
+	}
+
+	/// <summary>
+	/// Return type of a coroutine which awaits compute work. It starts right away and runs on its own, resumed by
+	/// ComputeContext::Pump, nothing has to keep it alive.
+	/// </summary>
+	struct ComputeTask
+	{
+		struct promise_type
+		{
+			ComputeTask get_return_object() { return {}; }
+			std::suspend_never initial_suspend() noexcept { return {}; }
+			std::suspend_never final_suspend() noexcept { return {}; }
+			void return_void() {}
+			void unhandled_exception() { std::terminate(); }
+		};
+	};
+}
@@ -0,0 +1,331 @@
+#include "UltraEngine.h"
+#include "ComputeContext.h"
+#include "ComputeUploader.h"
+#include "ComputeMemoryStats.h"
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	void BeginComputeFrame(const UltraEngine::Render::VkRenderer& renderer, shared_ptr<Object> extra)
+	{
+		auto hook = extra->As<ComputeFrameHook>();
+		if (hook == nullptr)
+		{
+			return;
+		}
+
+		auto world = hook->world.lock();
+		if (world == nullptr)
+		{
+			return;
+		}
+		ComputeContext::Get()->BeginWorld(renderer.commandbuffer, world.get());
+	}
+
+	ComputeContext::ComputeContext()
+	{
+		_frame = 0;
+	}
+
+	shared_ptr<ComputeContext> ComputeContext::Get()
+	{
+		static shared_ptr<ComputeContext> context = make_shared<ComputeContext>();
+		return context;
+	}
+
+	void ComputeContext::Attach(shared_ptr<World> world)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		for (int i = _worlds.size() - 1; i >= 0; i--)
+		{
+			auto attached = _worlds[i].lock();
+			if (attached == world)
+			{
+				return;
+			}
+			if (attached == nullptr)
+			{
+				_worlds.erase(_worlds.begin() + i);
+			}
+		}
+
+		_worlds.push_back(world);
+		auto hook = make_shared<ComputeFrameHook>();
+		hook->world = world;
+		world->AddHook(HookID::HOOKID_TRANSFER, BeginComputeFrame, hook, true);
+	}
+
+	uint64_t ComputeContext::GetFrame() const
+	{
+		return _frame.load();
+	}
+
+	void ComputeContext::BeginWorld(VkCommandBuffer commandBuffer, World* world)
+	{
+		// the renderer records each frame into the next of its command buffers, the hooks of all worlds rendered in a
+		// frame get the same one. A world seen twice with the same buffer means the buffer was reused for a new frame.
+		bool seen = std::find(_frameWorlds.begin(), _frameWorlds.end(), world) != _frameWorlds.end();
+		if (commandBuffer == _frameCommandBuffer && !seen)
+		{
+			_frameWorlds.push_back(world);
+			return;
+		}
+
+		_frameCommandBuffer = commandBuffer;
+		_frameWorlds.clear();
+		_frameWorlds.push_back(world);
+		BeginFrame(commandBuffer);
+	}
+
+	void ComputeContext::Enqueue(std::function<void()> task)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_pendingTasks.push_back(std::move(task));
+	}
+
+	void ComputeContext::Retire(std::function<void(VkDevice)> task)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_retiredTasks.push_back({ _frame.load(), std::move(task) });
+	}
+
+	void ComputeContext::Retire(VkPipeline pipeline)
+	{
+		if (pipeline == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(_mutex);
+		_retiredObjects[_frame.load() % (MAX_FRAMES_IN_FLIGHT + 1)].pipelines.push_back(pipeline);
+	}
+
+	void ComputeContext::Retire(VkPipelineLayout layout)
+	{
+		if (layout == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(_mutex);
+		_retiredObjects[_frame.load() % (MAX_FRAMES_IN_FLIGHT + 1)].pipelineLayouts.push_back(layout);
+	}
+
+	void ComputeContext::Retire(VkDescriptorSetLayout layout)
+	{
+		if (layout == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(_mutex);
+		_retiredObjects[_frame.load() % (MAX_FRAMES_IN_FLIGHT + 1)].setLayouts.push_back(layout);
+	}
+
+	void ComputeContext::Retire(VkDescriptorPool pool)
+	{
+		if (pool == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(_mutex);
+		_retiredObjects[_frame.load() % (MAX_FRAMES_IN_FLIGHT + 1)].descriptorPools.push_back(pool);
+	}
+
+	void ComputeContext::Retire(VkImageView view)
+	{
+		if (view == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(_mutex);
+		_retiredObjects[_frame.load() % (MAX_FRAMES_IN_FLIGHT + 1)].imageViews.push_back(view);
+	}
+
+	void ComputeContext::Retire(VkQueryPool pool)
+	{
+		if (pool == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(_mutex);
+		_retiredObjects[_frame.load() % (MAX_FRAMES_IN_FLIGHT + 1)].queryPools.push_back(pool);
+	}
+
+	void ComputeContext::Retire(VkDeviceMemory memory)
+	{
+		if (memory == VK_NULL_HANDLE)
+		{
+			return;
+		}
+		std::lock_guard<std::mutex> lock(_mutex);
+		_retiredObjects[_frame.load() % (MAX_FRAMES_IN_FLIGHT + 1)].memory.push_back(memory);
+	}
+
+	void ComputeContext::Retire(Utils::ComputeBuffer& buffer)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto& objects = _retiredObjects[_frame.load() % (MAX_FRAMES_IN_FLIGHT + 1)];
+			if (buffer.buffer != VK_NULL_HANDLE)
+			{
+				objects.buffers.push_back(buffer.buffer);
+			}
+			if (buffer.memory != VK_NULL_HANDLE)
+			{
+				objects.memory.push_back(buffer.memory);
+			}
+		}
+		buffer.buffer = VK_NULL_HANDLE;
+		buffer.memory = VK_NULL_HANDLE;
+		buffer.mapped = nullptr;
+	}
+
+	void ComputeContext::Record(std::function<bool(VkCommandBuffer)> task)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_pendingRecorders.push_back(std::move(task));
+	}
+
+	void ComputeContext::Prepare(std::function<bool(VkDevice)> task)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_pendingPreparers.push_back(std::move(task));
+	}
+
+	void ComputeContext::Post(std::function<void()> task)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_continuations.push_back(std::move(task));
+	}
+
+	void ComputeContext::Pump()
+	{
+		vector<std::function<void()>> tasks;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			std::swap(tasks, _continuations);
+		}
+
+		// tasks posted while these run, e.g. by a resumed coroutine, wait for the next call
+		for (auto& task : tasks)
+		{
+			task();
+		}
+	}
+
+	void ComputeContext::destroyObjects(VkDevice device)
+	{
+		auto stats = ComputeMemoryStats::Get();
+		for (auto pipeline : _destroying.pipelines)
+		{
+			vkDestroyPipeline(device, pipeline, nullptr);
+		}
+		for (auto layout : _destroying.pipelineLayouts)
+		{
+			vkDestroyPipelineLayout(device, layout, nullptr);
+		}
+		for (auto layout : _destroying.setLayouts)
+		{
+			vkDestroyDescriptorSetLayout(device, layout, nullptr);
+		}
+		for (auto pool : _destroying.descriptorPools)
+		{
+			stats->Untrack((uint64_t)pool);
+			vkDestroyDescriptorPool(device, pool, nullptr);
+		}
+		for (auto view : _destroying.imageViews)
+		{
+			stats->Untrack((uint64_t)view);
+			vkDestroyImageView(device, view, nullptr);
+		}
+		for (auto pool : _destroying.queryPools)
+		{
+			vkDestroyQueryPool(device, pool, nullptr);
+		}
+		for (auto buffer : _destroying.buffers)
+		{
+			vkDestroyBuffer(device, buffer, nullptr);
+		}
+		for (auto memory : _destroying.memory)
+		{
+			stats->Untrack((uint64_t)memory);
+			vkFreeMemory(device, memory, nullptr);
+		}
+
+		_destroying.pipelines.clear();
+		_destroying.pipelineLayouts.clear();
+		_destroying.setLayouts.clear();
+		_destroying.descriptorPools.clear();
+		_destroying.imageViews.clear();
+		_destroying.queryPools.clear();
+		_destroying.buffers.clear();
+		_destroying.memory.clear();
+	}
+
+	void ComputeContext::BeginFrame(VkCommandBuffer commandBuffer)
+	{
+		uint64_t frame = ++_frame;
+		VkDevice device = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device->device;
+
+		vector<std::function<void(VkDevice)>> completed;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			std::swap(_pendingTasks, _executingTasks);
+			_recorders.insert(_recorders.end(), _pendingRecorders.begin(), _pendingRecorders.end());
+			_pendingRecorders.clear();
+			_preparers.insert(_preparers.end(), _pendingPreparers.begin(), _pendingPreparers.end());
+			_pendingPreparers.clear();
+
+			// the tasks are queued in frame order, the due ones are at the front
+			size_t due = 0;
+			while (due < _retiredTasks.size() && _retiredTasks[due].frame + MAX_FRAMES_IN_FLIGHT <= frame)
+			{
+				completed.push_back(std::move(_retiredTasks[due].task));
+				due++;
+			}
+			_retiredTasks.erase(_retiredTasks.begin(), _retiredTasks.begin() + due);
+
+			// the bin of frame - MAX_FRAMES_IN_FLIGHT
+			std::swap(_destroying, _retiredObjects[(frame + 1) % (MAX_FRAMES_IN_FLIGHT + 1)]);
+		}
+
+		destroyObjects(device);
+
+		// outside the lock, the tasks may queue more work
+		for (auto& task : completed)
+		{
+			task(device);
+		}
+
+		for (auto& task : _executingTasks)
+		{
+			task();
+		}
+		_executingTasks.clear();
+
+		// resources released by the retired tasks no longer count against the budgets
+		ComputeMemoryStats::Get()->Update();
+
+		for (int i = 0; i < _preparers.size(); i++)
+		{
+			if (!_preparers[i](device))
+			{
+				_preparers.erase(_preparers.begin() + i);
+				i--;
+			}
+		}
+
+		// data written since the last frame, ahead of the frame's dispatches
+		ComputeUploader::Get()->Flush(commandBuffer);
+
+		for (int i = 0; i < _recorders.size(); i++)
+		{
+			if (!_recorders[i](commandBuffer))
+			{
+				_recorders.erase(_recorders.begin() + i);
+				i--;
+			}
+		}
+	}
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include "UltraEngine.h"
+#include "VulkanUtils.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	void BeginComputeFrame(const UltraEngine::Render::VkRenderer& renderer, shared_ptr<Object> extra);
+
+	// Extra of the frame hook, tells the hook which world it belongs to
+	class ComputeFrameHook : public Object
+	{
+	public:
+		weak_ptr<World> world;
+	};
+
+	/// <summary>
+	/// Shared state of the compute layer.
+	/// A persistent transfer hook is added to every world which dispatches compute shaders, it marks the frame boundary
+	/// on the rendering thread. Work which must not happen in the middle of a frame is queued here.
+	/// With several worlds the frame count still advances once per rendered frame: whichever hook runs first in a frame
+	/// begins it, recognized by the renderer's command buffer changing or by a world whose hook already ran reappearing.
+	/// </summary>
+	class ComputeContext : public Object
+	{
+	public:
+		// Frames the renderer may have in flight, anything retired in frame N is destroyed in frame N + MAX_FRAMES_IN_FLIGHT
+		static constexpr uint64_t MAX_FRAMES_IN_FLIGHT = 3;
+
+	private:
+		struct RetiredTask
+		{
+			uint64_t frame;
+			std::function<void(VkDevice)> task;
+		};
+
+		// Objects retired during one frame, destroyed together. The bins are reused, so their vectors keep their capacity.
+		struct RetiredObjects
+		{
+			vector<VkPipeline> pipelines;
+			vector<VkPipelineLayout> pipelineLayouts;
+			vector<VkDescriptorSetLayout> setLayouts;
+			vector<VkDescriptorPool> descriptorPools;
+			vector<VkImageView> imageViews;
+			vector<VkQueryPool> queryPools;
+			vector<VkBuffer> buffers;
+			vector<VkDeviceMemory> memory;
+		};
+
+		std::mutex _mutex;
+		vector<std::function<void()>> _pendingTasks;
+		vector<std::function<void()>> _executingTasks;
+		vector<RetiredTask> _retiredTasks;
+		// one bin per frame which may still be executing and one for the frame being recorded
+		RetiredObjects _retiredObjects[MAX_FRAMES_IN_FLIGHT + 1];
+		// rendering thread only, the bin being destroyed
+		RetiredObjects _destroying;
+		vector<std::function<bool(VkCommandBuffer)>> _pendingRecorders;
+		vector<std::function<bool(VkDevice)>> _pendingPreparers;
+		vector<std::function<void()>> _continuations;
+		// rendering thread only
+		vector<std::function<bool(VkCommandBuffer)>> _recorders;
+		vector<std::function<bool(VkDevice)>> _preparers;
+		vector<weak_ptr<World>> _worlds;
+		std::atomic<uint64_t> _frame;
+		// rendering thread only, the command buffer and the worlds seen since the frame began. The pointers only
+		// identify the worlds and are never dereferenced.
+		VkCommandBuffer _frameCommandBuffer = VK_NULL_HANDLE;
+		vector<World*> _frameWorlds;
+
+		void destroyObjects(VkDevice device);
+
+	public:
+		ComputeContext();
+		static shared_ptr<ComputeContext> Get();
+
+		// Adds the frame hook to the world, does nothing if it was already attached
+		void Attach(shared_ptr<World> world);
+		uint64_t GetFrame() const;
+
+		// Runs the task on the rendering thread at the beginning of the next frame
+		void Enqueue(std::function<void()> task);
+		// Runs the task once the frames which may still use the retired objects have completed
+		void Retire(std::function<void(VkDevice)> task);
+		// Destroys the object once the frames which may still use it have completed. Objects are queued in a bin per frame
+		// which is destroyed at once, prefer these to a task per object.
+		void Retire(VkPipeline pipeline);
+		void Retire(VkPipelineLayout layout);
+		void Retire(VkDescriptorSetLayout layout);
+		void Retire(VkDescriptorPool pool);
+		void Retire(VkImageView view);
+		void Retire(VkQueryPool pool);
+		void Retire(VkDeviceMemory memory);
+		// Takes the buffer and its memory, the handles are cleared
+		void Retire(Utils::ComputeBuffer& buffer);
+		// Calls the task with the command buffer of every frame, starting with the next one, until it returns false
+		void Record(std::function<bool(VkCommandBuffer)> task);
+		// Calls the task at the beginning of every frame, starting with the next one, until it returns false. The tasks
+		// run before the uploader's batch is recorded, so the data they write is uploaded with one flush for the frame.
+		void Prepare(std::function<bool(VkDevice)> task);
+
+		// Queues a task for the next Pump, e.g. the continuation of completed GPU work (see ComputeCompletion)
+		void Post(std::function<void()> task);
+		// Runs the posted tasks on the calling thread, call once per frame from the game loop
+		void Pump();
+
+		// Called by the frame hook of every world, begins the frame for the first one rendered in it
+		void BeginWorld(VkCommandBuffer commandBuffer, World* world);
+		void BeginFrame(VkCommandBuffer commandBuffer);
+	};
+}
@@ -0,0 +1,134 @@
+#include "UltraEngine.h"
+#include "ComputeFormat.h"
+#include <atomic>
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	static std::atomic<bool> ExtendedStorageFormats = false;
+
+	struct StorageFormatInfo
+	{
+		VkFormat format;
+		const char* qualifier;
+		int size;
+		// needs shaderStorageImageExtendedFormats, everything else is a required storage format
+		bool extended;
+	};
+
+	static const StorageFormatInfo storageFormats[] =
+	{
+		{ VK_FORMAT_R8_UNORM, "r8", 1, true },
+		{ VK_FORMAT_R8G8_UNORM, "rg8", 2, true },
+		{ VK_FORMAT_R8G8B8A8_UNORM, "rgba8", 4, false },
+		{ VK_FORMAT_R8G8B8A8_SNORM, "rgba8_snorm", 4, false },
+		{ VK_FORMAT_B10G11R11_UFLOAT_PACK32, "r11f_g11f_b10f", 4, true },
+		{ VK_FORMAT_A2B10G10R10_UNORM_PACK32, "rgb10_a2", 4, true },
+		{ VK_FORMAT_R16_SFLOAT, "r16f", 2, true },
+		{ VK_FORMAT_R16G16_SFLOAT, "rg16f", 4, true },
+		{ VK_FORMAT_R16G16B16A16_SFLOAT, "rgba16f", 8, false },
+		{ VK_FORMAT_R16_UNORM, "r16", 2, true },
+		{ VK_FORMAT_R16G16_UNORM, "rg16", 4, true },
+		{ VK_FORMAT_R16G16B16A16_UNORM, "rgba16", 8, true },
+		{ VK_FORMAT_R32_SFLOAT, "r32f", 4, false },
+		{ VK_FORMAT_R32G32_SFLOAT, "rg32f", 8, false },
+		{ VK_FORMAT_R32G32B32A32_SFLOAT, "rgba32f", 16, false },
+		{ VK_FORMAT_R32_UINT, "r32ui", 4, false },
+		{ VK_FORMAT_R32G32_UINT, "rg32ui", 8, false },
+		{ VK_FORMAT_R32G32B32A32_UINT, "rgba32ui", 16, false },
+	};
+
+	static const StorageFormatInfo* findStorageFormat(VkFormat format)
+	{
+		for (auto& info : storageFormats)
+		{
+			if (info.format == format)
+			{
+				return &info;
+			}
+		}
+		return nullptr;
+	}
+
+	static VkFormat getCandidate(ComputePrecision precision, int channels)
+	{
+		switch (precision)
+		{
+		case ComputePrecision::UNORM8:
+			return channels == 1 ? VK_FORMAT_R8_UNORM : channels == 2 ? VK_FORMAT_R8G8_UNORM : VK_FORMAT_R8G8B8A8_UNORM;
+		case ComputePrecision::PACKED_FLOAT:
+			return channels == 3 ? VK_FORMAT_B10G11R11_UFLOAT_PACK32 : VK_FORMAT_UNDEFINED;
+		case ComputePrecision::HALF:
+			return channels == 1 ? VK_FORMAT_R16_SFLOAT : channels == 2 ? VK_FORMAT_R16G16_SFLOAT : VK_FORMAT_R16G16B16A16_SFLOAT;
+		}
+		return channels == 1 ? VK_FORMAT_R32_SFLOAT : channels == 2 ? VK_FORMAT_R32G32_SFLOAT : VK_FORMAT_R32G32B32A32_SFLOAT;
+	}
+
+	bool IsStorageFormatSupported(TextureFormat format)
+	{
+		auto info = findStorageFormat(VkFormat(format));
+		if (info == nullptr)
+		{
+			return false;
+		}
+
+		// the physical device reporting the feature does not mean the engine enabled it on the logical device
+		if (info->extended && !ExtendedStorageFormats)
+		{
+			return false;
+		}
+
+		VkPhysicalDevice physicalDevice = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device->physicaldevice;
+		return tools::formatIsStorage(physicalDevice, info->format);
+	}
+
+	bool EnableExtendedStorageFormats(bool enable)
+	{
+		if (enable)
+		{
+			VkPhysicalDevice physicalDevice = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device->physicaldevice;
+			VkPhysicalDeviceFeatures features;
+			vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+			if (!features.shaderStorageImageExtendedFormats)
+			{
+				Print("Error: The device does not support extended storage image formats");
+				ExtendedStorageFormats = false;
+				return false;
+			}
+		}
+		ExtendedStorageFormats = enable;
+		return true;
+	}
+
+	bool HasExtendedStorageFormats()
+	{
+		return ExtendedStorageFormats;
+	}
+
+	TextureFormat GetStorageFormat(ComputePrecision precision, int channels)
+	{
+		for (int p = int(precision); p <= int(ComputePrecision::FULL); p++)
+		{
+			VkFormat format = getCandidate(ComputePrecision(p), channels);
+			if (format != VK_FORMAT_UNDEFINED && IsStorageFormatSupported(TextureFormat(format)))
+			{
+				return TextureFormat(format);
+			}
+		}
+		return TextureFormat(VK_FORMAT_R32G32B32A32_SFLOAT);
+	}
+
+	String GetStorageFormatQualifier(TextureFormat format)
+	{
+		auto info = findStorageFormat(VkFormat(format));
+		return info != nullptr ? String(info->qualifier) : String();
+	}
+
+	int GetStorageFormatSize(TextureFormat format)
+	{
+		auto info = findStorageFormat(VkFormat(format));
+		return info != nullptr ? info->size : 0;
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "UltraEngine.h"
+#include "VulkanUtils.h"
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	/// <summary>
+	/// Precision a compute shader needs for a storage image, from the cheapest to the most expensive.
+	/// </summary>
+	enum class ComputePrecision
+	{
+		// 8 bit unorm, colors and masks in the 0 - 1 range
+		UNORM8,
+		// r11g11b10f, unsigned HDR color without alpha in 4 bytes. Only available with three channels.
+		PACKED_FLOAT,
+		// 16 bit float
+		HALF,
+		// 32 bit float
+		FULL
+	};
+
+	/// <summary>
+	/// Picks the narrowest storage image format the device supports for a precision class and channel count (1, 2, 3 or 4).
+	/// Formats which are not supported fall back to the next wider precision, three channels use four channel formats
+	/// unless PACKED_FLOAT is available. rgba8, rgba16f and the 32 bit float formats are always available, the narrower
+	/// ones only after EnableExtendedStorageFormats.
+	/// </summary>
+	TextureFormat GetStorageFormat(ComputePrecision precision, int channels = 4);
+
+	// Returns if the format can be used as storage image. Formats outside the set the Vulkan spec requires for storage
+	// images need shaderStorageImageExtendedFormats and are only reported after EnableExtendedStorageFormats(true).
+	bool IsStorageFormatSupported(TextureFormat format);
+
+	// The engine creates the Vulkan device and whether it enabled shaderStorageImageExtendedFormats can not be queried,
+	// so the extended formats are only used once the application confirmed it. Returns false, and stays disabled, if the
+	// physical device does not support the feature.
+	bool EnableExtendedStorageFormats(bool enable);
+	bool HasExtendedStorageFormats();
+
+	// GLSL layout qualifier of a storage format, e.g. "rgba16f". Returns an empty string for formats which can't be declared in GLSL.
+	String GetStorageFormatQualifier(TextureFormat format);
+
+	// Size of a texel in bytes
+	int GetStorageFormatSize(TextureFormat format);
+}
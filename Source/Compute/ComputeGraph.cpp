@@ -0,0 +1,675 @@
+#include "UltraEngine.h"
+#include "ComputeGraph.h"
+#include "ComputeMemoryStats.h"
+#include <algorithm>
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	// One execution of a graph, with the groups and push constants the passes had when it was submitted
+	class ComputeGraphExecution : public Object
+	{
+	public:
+		shared_ptr<ComputeGraph> graph;
+		vector<ComputePass> passes;
+		shared_ptr<ComputeCompletion> completion;
+	};
+
+	void RecordComputeGraph(const UltraEngine::Render::VkRenderer& renderer, shared_ptr<Object> extra)
+	{
+		auto execution = extra->As<ComputeGraphExecution>();
+		if (execution != nullptr)
+		{
+			execution->graph->Record(renderer.commandbuffer, execution->passes);
+			execution->completion->Signal();
+		}
+	}
+
+	int ComputeGraphPass::bind(int resource, bool write, bool sampled)
+	{
+		auto graph = _graph.lock();
+		if (graph == nullptr || resource < 0 || resource >= graph->_resources.size())
+		{
+			Print("Error: ComputeGraphPass resource does not belong to the graph");
+			return -1;
+		}
+		if (graph->_compiled)
+		{
+			Print("Error: ComputeGraph can not be changed once compiled");
+			return -1;
+		}
+
+		auto& declared = graph->_resources[resource];
+		int binding;
+		if (declared.buffer)
+		{
+			if (sampled)
+			{
+				Print("Error: ComputeGraphPass::Sample needs a texture resource");
+				return -1;
+			}
+			binding = _shader->AddStorageBuffer(declared.storage);
+		}
+		else
+		{
+			// transient textures are bound once the graph has picked their pool texture
+			binding = sampled ? _shader->AddSampler(declared.texture) : _shader->AddTargetImage(declared.texture);
+		}
+
+		_accesses.push_back({ resource, binding, write });
+		return binding;
+	}
+
+	int ComputeGraphPass::Read(int resource)
+	{
+		return bind(resource, false, false);
+	}
+
+	int ComputeGraphPass::Write(int resource)
+	{
+		return bind(resource, true, false);
+	}
+
+	int ComputeGraphPass::Sample(int resource)
+	{
+		return bind(resource, false, true);
+	}
+
+	void ComputeGraphPass::SetPushConstants(const void* data, size_t size)
+	{
+		_pushConstantsSize = std::min(size, sizeof(_pushConstants));
+		if (data != nullptr)
+		{
+			memcpy(_pushConstants, data, _pushConstantsSize);
+		}
+	}
+
+	void ComputeGraphPass::SetGroups(int tx, int ty, int tz)
+	{
+		_tx = tx;
+		_ty = ty;
+		_tz = tz;
+	}
+
+	ComputeGraph::~ComputeGraph()
+	{
+		// the buffers placed in it are retired by their own destructors
+		ComputeContext::Get()->Retire(_transientMemory);
+	}
+
+	shared_ptr<ComputeGraph> ComputeGraph::Create()
+	{
+		return make_shared<ComputeGraph>();
+	}
+
+	int ComputeGraph::addResource(const Resource& resource)
+	{
+		if (_compiled)
+		{
+			Print("Error: ComputeGraph can not be changed once compiled");
+			return -1;
+		}
+
+		_resources.push_back(resource);
+		return _resources.size() - 1;
+	}
+
+	int ComputeGraph::ImportTexture(shared_ptr<Texture> texture)
+	{
+		Resource resource;
+		resource.imported = true;
+		resource.texture = texture;
+		return addResource(resource);
+	}
+
+	int ComputeGraph::ImportBuffer(shared_ptr<ComputeStorageBuffer> buffer)
+	{
+		Resource resource;
+		resource.buffer = true;
+		resource.imported = true;
+		resource.storage = buffer;
+		return addResource(resource);
+	}
+
+	int ComputeGraph::CreateTransientTexture(int width, int height, TextureFormat format)
+	{
+		Resource resource;
+		resource.width = width;
+		resource.height = height;
+		resource.format = format;
+		return addResource(resource);
+	}
+
+	int ComputeGraph::CreateTransientBuffer(size_t size)
+	{
+		if (_compiled)
+		{
+			Print("Error: ComputeGraph can not be changed once compiled");
+			return -1;
+		}
+
+		Resource resource;
+		resource.buffer = true;
+		resource.storage = ComputeStorageBuffer::CreateUnbound(size);
+		return addResource(resource);
+	}
+
+	shared_ptr<ComputeGraphPass> ComputeGraph::AddPass(const string& name, shared_ptr<ComputeShader> shader, int tx, int ty, int tz, const void* pushData, size_t pushDataSize)
+	{
+		if (_compiled)
+		{
+			Print("Error: ComputeGraph can not be changed once compiled");
+			return nullptr;
+		}
+
+		auto pass = make_shared<ComputeGraphPass>();
+		pass->_graph = Self()->As<ComputeGraph>();
+		pass->_name = name;
+		pass->_shader = shader;
+		pass->SetGroups(tx, ty, tz);
+		pass->SetPushConstants(pushData, pushDataSize);
+		_passes.push_back(pass);
+		return pass;
+	}
+
+	vector<bool> ComputeGraph::cull()
+	{
+		vector<bool> needed(_resources.size(), false);
+		for (int i = 0; i < _resources.size(); i++)
+		{
+			needed[i] = _resources[i].imported;
+		}
+
+		// backwards, a pass is kept if a later kept pass or the application uses what it writes
+		vector<bool> live(_passes.size(), false);
+		for (int p = int(_passes.size()) - 1; p >= 0; p--)
+		{
+			bool writes = false;
+			bool contributes = false;
+			for (auto& access : _passes[p]->_accesses)
+			{
+				if (access.write)
+				{
+					writes = true;
+					contributes |= needed[access.resource];
+				}
+			}
+
+			// without declared writes the effect of the pass is unknown, so it stays
+			live[p] = contributes || !writes;
+			if (live[p])
+			{
+				for (auto& access : _passes[p]->_accesses)
+				{
+					needed[access.resource] = true;
+				}
+			}
+		}
+
+		_culledPasses = std::count(live.begin(), live.end(), false);
+		return live;
+	}
+
+	void ComputeGraph::schedule(const vector<bool>& live)
+	{
+		// the declaration order defines what each pass sees, a pass waits for the last writer of everything it uses
+		// and writers also wait for the readers of the previous content
+		vector<int> levels(_passes.size(), -1);
+		vector<int> lastWriter(_resources.size(), -1);
+		vector<vector<int>> readers(_resources.size());
+
+		_levels.clear();
+		for (int p = 0; p < _passes.size(); p++)
+		{
+			if (!live[p])
+			{
+				continue;
+			}
+
+			int level = 0;
+			for (auto& access : _passes[p]->_accesses)
+			{
+				if (lastWriter[access.resource] >= 0)
+				{
+					level = std::max(level, levels[lastWriter[access.resource]] + 1);
+				}
+				if (access.write)
+				{
+					for (int reader : readers[access.resource])
+					{
+						level = std::max(level, levels[reader] + 1);
+					}
+				}
+			}
+			levels[p] = level;
+
+			for (auto& access : _passes[p]->_accesses)
+			{
+				if (access.write && lastWriter[access.resource] != p)
+				{
+					lastWriter[access.resource] = p;
+					readers[access.resource].clear();
+				}
+			}
+			for (auto& access : _passes[p]->_accesses)
+			{
+				if (!access.write && lastWriter[access.resource] != p)
+				{
+					readers[access.resource].push_back(p);
+				}
+
+				auto& resource = _resources[access.resource];
+				resource.first = resource.first < 0 ? level : std::min(resource.first, level);
+				resource.last = std::max(resource.last, level);
+			}
+
+			if (_levels.size() <= level)
+			{
+				_levels.resize(level + 1);
+			}
+			_levels[level].push_back(p);
+		}
+	}
+
+	void ComputeGraph::allocateTextures()
+	{
+		vector<int> transients;
+		for (int i = 0; i < _resources.size(); i++)
+		{
+			if (!_resources[i].buffer && !_resources[i].imported && _resources[i].first >= 0)
+			{
+				transients.push_back(i);
+			}
+		}
+		std::stable_sort(transients.begin(), transients.end(), [this](int a, int b) { return _resources[a].first < _resources[b].first; });
+
+		// a pool texture is reused once its last user has finished, one level barrier separates the two
+		for (int index : transients)
+		{
+			auto& resource = _resources[index];
+			for (int i = 0; i < _texturePool.size(); i++)
+			{
+				auto& pooled = _texturePool[i];
+				if (pooled.busyUntil < resource.first && pooled.width == resource.width && pooled.height == resource.height && pooled.format == resource.format)
+				{
+					resource.physical = i;
+					break;
+				}
+			}
+
+			if (resource.physical < 0)
+			{
+				PooledTexture pooled;
+				pooled.texture = CreateTexture(TEXTURE_2D, resource.width, resource.height, resource.format, {}, 1, TEXTURE_STORAGE, TEXTUREFILTER_LINEAR);
+				pooled.width = resource.width;
+				pooled.height = resource.height;
+				pooled.format = resource.format;
+				resource.physical = _texturePool.size();
+				_texturePool.push_back(pooled);
+			}
+			_texturePool[resource.physical].busyUntil = resource.last;
+		}
+
+		for (auto& pass : _passes)
+		{
+			for (auto& access : pass->_accesses)
+			{
+				auto& resource = _resources[access.resource];
+				if (resource.physical >= 0)
+				{
+					pass->_shader->UpdateTexture(access.binding, _texturePool[resource.physical].texture);
+				}
+			}
+		}
+	}
+
+	void ComputeGraph::allocateBuffers()
+	{
+		struct Placement
+		{
+			int resource;
+			VkDeviceSize offset;
+			VkDeviceSize end;
+		};
+
+		vector<int> transients;
+		for (int i = 0; i < _resources.size(); i++)
+		{
+			if (_resources[i].buffer && !_resources[i].imported && _resources[i].first >= 0)
+			{
+				transients.push_back(i);
+			}
+		}
+		if (transients.empty())
+		{
+			return;
+		}
+
+		// largest first, each buffer takes the lowest offset which is free during its whole lifetime
+		std::stable_sort(transients.begin(), transients.end(), [this](int a, int b) { return _resources[a].storage->GetSize() > _resources[b].storage->GetSize(); });
+
+		vector<Placement> placements;
+		uint32_t memoryTypeBits = 0xffffffff;
+		for (int index : transients)
+		{
+			auto& resource = _resources[index];
+			VkMemoryRequirements requirements = resource.storage->GetMemoryRequirements();
+			memoryTypeBits &= requirements.memoryTypeBits;
+
+			vector<Placement*> overlapping;
+			vector<VkDeviceSize> candidates = { 0 };
+			for (auto& placement : placements)
+			{
+				auto& other = _resources[placement.resource];
+				if (other.last >= resource.first && resource.last >= other.first)
+				{
+					overlapping.push_back(&placement);
+					candidates.push_back(placement.end);
+				}
+			}
+			std::sort(candidates.begin(), candidates.end());
+
+			VkDeviceSize offset = 0;
+			for (VkDeviceSize candidate : candidates)
+			{
+				offset = (candidate + requirements.alignment - 1) / requirements.alignment * requirements.alignment;
+				bool free = true;
+				for (auto placement : overlapping)
+				{
+					if (offset < placement->end && placement->offset < offset + requirements.size)
+					{
+						free = false;
+						break;
+					}
+				}
+				if (free)
+				{
+					break;
+				}
+			}
+
+			placements.push_back({ index, offset, offset + requirements.size });
+			_transientMemorySize = std::max(_transientMemorySize, offset + requirements.size);
+		}
+
+		auto device = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device;
+		VkMemoryAllocateInfo memAlloc = initializers::memoryAllocateInfo();
+		memAlloc.allocationSize = _transientMemorySize;
+		memAlloc.memoryTypeIndex = device->FindMemoryType(memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		VK_CHECK_RESULT(vkAllocateMemory(device->device, &memAlloc, nullptr, &_transientMemory));
+		{
+			ComputeMemoryScope scope("ComputeGraph");
+			ComputeMemoryStats::Get()->Track((uint64_t)_transientMemory, ComputeResourceType::DEVICE_MEMORY, _transientMemorySize, ComputeMemoryStats::Get()->GetHeap(memAlloc.memoryTypeIndex));
+		}
+
+		for (auto& placement : placements)
+		{
+			_resources[placement.resource].storage->BindMemory(_transientMemory, placement.offset);
+		}
+	}
+
+	void ComputeGraph::buildBarriers()
+	{
+		// hazards since the last barrier covering the resource
+		vector<bool> used(_resources.size(), false);
+		vector<bool> written(_resources.size(), false);
+		vector<bool> read(_resources.size(), false);
+		vector<bool> modified(_resources.size(), false);
+		// buffers share one memory barrier, earlier work outside the graph counts as a write
+		bool buffersWritten = true;
+		bool buffersRead = false;
+		bool buffersExternal = true;
+
+		_barriers.assign(_levels.size() + 1, Barrier());
+		for (int level = 0; level < _levels.size(); level++)
+		{
+			auto& barrier = _barriers[level];
+			vector<bool> covered(_resources.size(), false);
+			bool usesBuffers = false;
+			bool writesBuffers = false;
+
+			for (int p : _levels[level])
+			{
+				for (auto& access : _passes[p]->_accesses)
+				{
+					auto& resource = _resources[access.resource];
+					if (resource.buffer)
+					{
+						usesBuffers = true;
+						writesBuffers |= access.write;
+						continue;
+					}
+					if (covered[access.resource])
+					{
+						continue;
+					}
+
+					auto texture = resource.imported ? resource.texture : _texturePool[resource.physical].texture;
+					if (!used[access.resource])
+					{
+						barrier.images.push_back({ texture, !resource.imported, resource.imported });
+						covered[access.resource] = true;
+						if (resource.imported)
+						{
+							barrier.srcStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+						}
+					}
+					else if (written[access.resource] || (access.write && read[access.resource]))
+					{
+						barrier.images.push_back({ texture, false, false });
+						covered[access.resource] = true;
+					}
+				}
+			}
+
+			if (usesBuffers && (buffersWritten || (writesBuffers && buffersRead)))
+			{
+				barrier.memory = true;
+				if (buffersExternal)
+				{
+					barrier.srcStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+				}
+				buffersWritten = false;
+				buffersRead = false;
+				buffersExternal = false;
+			}
+
+			for (int i = 0; i < _resources.size(); i++)
+			{
+				if (covered[i])
+				{
+					written[i] = false;
+					read[i] = false;
+				}
+			}
+			for (int p : _levels[level])
+			{
+				for (auto& access : _passes[p]->_accesses)
+				{
+					used[access.resource] = true;
+					modified[access.resource] = modified[access.resource] || access.write;
+					if (_resources[access.resource].buffer)
+					{
+						buffersWritten |= access.write;
+						buffersRead |= !access.write;
+					}
+					else
+					{
+						written[access.resource] = written[access.resource] || access.write;
+						read[access.resource] = read[access.resource] || !access.write;
+					}
+				}
+			}
+		}
+
+		// imported results are made visible to whatever uses them after the graph
+		auto& last = _barriers.back();
+		last.dstStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+		last.dstAccess = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+		for (int i = 0; i < _resources.size(); i++)
+		{
+			if (!_resources[i].imported || !modified[i])
+			{
+				continue;
+			}
+			if (_resources[i].buffer)
+			{
+				last.memory = true;
+			}
+			else
+			{
+				last.images.push_back({ _resources[i].texture, false, false });
+			}
+		}
+	}
+
+	void ComputeGraph::Compile()
+	{
+		if (_compiled)
+		{
+			return;
+		}
+
+		auto live = cull();
+		schedule(live);
+		allocateTextures();
+		allocateBuffers();
+		buildBarriers();
+		_compiled = true;
+
+		// every binding is known now, the pipelines build on the compiler thread ahead of the first execution
+		vector<shared_ptr<ComputeShader>> shaders;
+		for (auto& level : _levels)
+		{
+			for (int pass : level)
+			{
+				shaders.push_back(_passes[pass]->_shader);
+			}
+		}
+		ComputeShader::Precompile(shaders);
+	}
+
+	size_t ComputeGraph::CountBarriers() const
+	{
+		size_t count = 0;
+		for (auto& barrier : _barriers)
+		{
+			if (barrier.memory || !barrier.images.empty())
+			{
+				count++;
+			}
+		}
+		return count;
+	}
+
+	shared_ptr<Texture> ComputeGraph::GetTexture(int resource) const
+	{
+		if (resource < 0 || resource >= _resources.size() || _resources[resource].buffer)
+		{
+			return nullptr;
+		}
+		if (_resources[resource].imported)
+		{
+			return _resources[resource].texture;
+		}
+		return _resources[resource].physical >= 0 ? _texturePool[_resources[resource].physical].texture : nullptr;
+	}
+
+	shared_ptr<ComputeStorageBuffer> ComputeGraph::GetBuffer(int resource) const
+	{
+		if (resource < 0 || resource >= _resources.size())
+		{
+			return nullptr;
+		}
+		return _resources[resource].storage;
+	}
+
+	shared_ptr<ComputeCompletion> ComputeGraph::Execute(shared_ptr<World> world, ComputeHook hook)
+	{
+		Compile();
+
+		auto execution = make_shared<ComputeGraphExecution>();
+		execution->graph = Self()->As<ComputeGraph>();
+		execution->completion = ComputeCompletion::Create();
+		execution->passes.resize(_passes.size());
+		for (int p = 0; p < _passes.size(); p++)
+		{
+			auto& pass = execution->passes[p];
+			pass.shader = _passes[p]->_shader;
+			pass.tx = _passes[p]->_tx;
+			pass.ty = _passes[p]->_ty;
+			pass.tz = _passes[p]->_tz;
+			pass.pushConstantsSize = _passes[p]->_pushConstantsSize;
+			memcpy(pass.pushConstants, _passes[p]->_pushConstants, pass.pushConstantsSize);
+		}
+
+		if (ComputeShader::DescriptorPool == nullptr)
+		{
+			ComputeShader::DescriptorPool = make_shared<ComputeDescriptorPool>(world);
+		}
+
+		ComputeContext::Get()->Attach(world);
+		switch (hook)
+		{
+		case ComputeHook::RENDER:
+			world->AddHook(HookID::HOOKID_RENDER, RecordComputeGraph, execution, false);
+			break;
+		case ComputeHook::TRANSFER:
+			world->AddHook(HookID::HOOKID_TRANSFER, RecordComputeGraph, execution, false);
+			break;
+		}
+		return execution->completion;
+	}
+
+	void ComputeGraph::recordBarrier(VkCommandBuffer commandBuffer, const Barrier& barrier)
+	{
+		if (!barrier.memory && barrier.images.empty())
+		{
+			return;
+		}
+
+		vector<VkImageMemoryBarrier> imageBarriers;
+		imageBarriers.reserve(barrier.images.size());
+		for (auto& image : barrier.images)
+		{
+			VkImageMemoryBarrier imageBarrier = initializers::imageMemoryBarrier();
+			imageBarrier.image = image.texture->GetImage();
+			imageBarrier.srcAccessMask = image.external ? VK_ACCESS_MEMORY_WRITE_BIT : VK_ACCESS_SHADER_WRITE_BIT;
+			imageBarrier.dstAccessMask = barrier.dstAccess;
+			imageBarrier.oldLayout = image.discard ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_GENERAL;
+			imageBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+			imageBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS };
+			imageBarriers.push_back(imageBarrier);
+		}
+
+		VkMemoryBarrier memoryBarrier = initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+		memoryBarrier.dstAccessMask = barrier.dstAccess;
+
+		vkCmdPipelineBarrier(commandBuffer, barrier.srcStage, barrier.dstStage, 0,
+			barrier.memory ? 1 : 0, &memoryBarrier, 0, nullptr, static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+	}
+
+	void ComputeGraph::Record(VkCommandBuffer commandBuffer, vector<ComputePass>& passes)
+	{
+		for (int level = 0; level < _levels.size(); level++)
+		{
+			recordBarrier(commandBuffer, _barriers[level]);
+
+			// no barriers within a level, its passes are independent
+			for (int p : _levels[level])
+			{
+				auto& pass = passes[p];
+				ComputeTile tile;
+				tile.tx = pass.tx;
+				tile.ty = pass.ty;
+				tile.tz = pass.tz;
+				pass.shader->DispatchTiles(commandBuffer, &tile, 1, ComputeImageSync::EXTERNAL,
+					pass.pushConstantsSize > 0 ? pass.pushConstants : nullptr, pass.pushConstantsSize, 0);
+			}
+		}
+		recordBarrier(commandBuffer, _barriers.back());
+	}
+}
@@ -0,0 +1,174 @@
+#pragma once
+#include "UltraEngine.h"
+#include "ComputeShader.h"
+#include "ComputePass.h"
+#include "ComputeStorageBuffer.h"
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	class ComputeGraph;
+
+	void RecordComputeGraph(const UltraEngine::Render::VkRenderer& renderer, shared_ptr<Object> extra);
+
+	/// <summary>
+	/// A dispatch of a ComputeGraph. The resources it reads and writes are declared through the pass, which binds them to
+	/// the next binding of its shader: the calls have to follow the binding order of the shader, mixed with the shader's
+	/// own Add calls for anything the graph does not track.
+	/// </summary>
+	class ComputeGraphPass : public Object
+	{
+		friend class ComputeGraph;
+
+	private:
+		struct Access
+		{
+			int resource;
+			int binding;
+			bool write;
+		};
+
+		weak_ptr<ComputeGraph> _graph;
+		string _name;
+		shared_ptr<ComputeShader> _shader;
+		int _tx = 1;
+		int _ty = 1;
+		int _tz = 1;
+		uint8_t _pushConstants[128];
+		size_t _pushConstantsSize = 0;
+		vector<Access> _accesses;
+
+		int bind(int resource, bool write, bool sampled);
+
+	public:
+		// Storage image or storage buffer the pass only reads
+		int Read(int resource);
+		// Storage image or storage buffer the pass writes and may read as well
+		int Write(int resource);
+		// Texture the pass reads through a sampler
+		int Sample(int resource);
+
+		// Push constants are copied, up to 128 bytes. Changes apply from the next Execute.
+		void SetPushConstants(const void* data, size_t size);
+		void SetGroups(int tx, int ty, int tz);
+
+		const string& GetName() const { return _name; }
+		shared_ptr<ComputeShader> GetShader() const { return _shader; }
+	};
+
+	/// <summary>
+	/// Compute passes with declared reads and writes, from which the graph derives the order, the barriers and the memory.
+	/// Passes run in levels: each level holds the passes whose inputs are complete, in declaration order, so independent
+	/// passes end up next to each other and overlap on the GPU. Between two levels a single barrier covers every hazard
+	/// of the next level, passes within a level need none. Passes which contribute nothing to an imported resource are culled.
+	///
+	/// Imported resources belong to the application and keep their content. Transient resources only live within an
+	/// execution: transient buffers whose lifetimes do not overlap share the same device memory, transient textures are
+	/// taken from a pool of textures with the same size and format, as engine textures can not be placed in shared memory.
+	///
+	/// The graph is compiled by its first Execute and can not be changed afterwards, except for the groups and
+	/// push constants of its passes.
+	/// </summary>
+	class ComputeGraph : public Object
+	{
+		friend class ComputeGraphPass;
+
+	private:
+		struct Resource
+		{
+			bool buffer = false;
+			bool imported = false;
+			shared_ptr<Texture> texture;
+			int width = 0;
+			int height = 0;
+			TextureFormat format = {};
+			shared_ptr<ComputeStorageBuffer> storage;
+			// levels of the first and last pass using the resource
+			int first = -1;
+			int last = -1;
+			// pool texture of a transient texture
+			int physical = -1;
+		};
+
+		struct ImageBarrier
+		{
+			shared_ptr<Texture> texture;
+			// first use of a transient texture, its content is discarded
+			bool discard;
+			// first use of an imported texture, which may come from any earlier work
+			bool external;
+		};
+
+		struct Barrier
+		{
+			vector<ImageBarrier> images;
+			bool memory = false;
+			VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			VkAccessFlags dstAccess = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		};
+
+		struct PooledTexture
+		{
+			shared_ptr<Texture> texture;
+			int width;
+			int height;
+			TextureFormat format;
+			// last level of the transient texture currently assigned
+			int busyUntil;
+		};
+
+		vector<Resource> _resources;
+		vector<shared_ptr<ComputeGraphPass>> _passes;
+
+		// compiled
+		bool _compiled = false;
+		vector<vector<int>> _levels;
+		// barriers in front of each level and, as last element, behind the last one
+		vector<Barrier> _barriers;
+		vector<PooledTexture> _texturePool;
+		VkDeviceMemory _transientMemory = VK_NULL_HANDLE;
+		VkDeviceSize _transientMemorySize = 0;
+		size_t _culledPasses = 0;
+
+		int addResource(const Resource& resource);
+		vector<bool> cull();
+		void schedule(const vector<bool>& live);
+		void allocateTextures();
+		void allocateBuffers();
+		void buildBarriers();
+		void recordBarrier(VkCommandBuffer commandBuffer, const Barrier& barrier);
+
+	public:
+		virtual ~ComputeGraph();
+		static shared_ptr<ComputeGraph> Create();
+
+		// Resources owned by the application, their content is kept and passes writing them are never culled
+		int ImportTexture(shared_ptr<Texture> texture);
+		int ImportBuffer(shared_ptr<ComputeStorageBuffer> buffer);
+		// Resources which only exist during an execution, their content is undefined when the first pass using them starts
+		int CreateTransientTexture(int width, int height, TextureFormat format);
+		int CreateTransientBuffer(size_t size);
+
+		shared_ptr<ComputeGraphPass> AddPass(const string& name, shared_ptr<ComputeShader> shader, int tx, int ty, int tz, const void* pushData = nullptr, size_t pushDataSize = 0);
+
+		// Sorts and culls the passes, allocates the transient resources and binds them to the shaders.
+		// Called by the first Execute, call it up front to allocate the memory ahead of time.
+		void Compile();
+		// Records the graph once, in the hook of the next frame. The handle completes once the GPU has executed it.
+		shared_ptr<ComputeCompletion> Execute(shared_ptr<World> world, ComputeHook hook = ComputeHook::TRANSFER);
+		// Records the compiled passes with the groups and push constants of the passes given in declaration order
+		void Record(VkCommandBuffer commandBuffer, vector<ComputePass>& passes);
+
+		// Only valid once compiled
+		size_t CountLevels() const { return _levels.size(); }
+		size_t CountCulledPasses() const { return _culledPasses; }
+		size_t CountBarriers() const;
+		// Device memory shared by the transient buffers
+		VkDeviceSize GetTransientMemorySize() const { return _transientMemorySize; }
+		// Pool texture of a transient texture, e.g. for debugging
+		shared_ptr<Texture> GetTexture(int resource) const;
+		shared_ptr<ComputeStorageBuffer> GetBuffer(int resource) const;
+	};
+}
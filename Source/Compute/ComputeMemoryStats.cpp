@@ -0,0 +1,217 @@
+#include "UltraEngine.h"
+#include "ComputeMemoryStats.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	static thread_local string CurrentOwner;
+
+	static const char* ResourceTypeNames[int(ComputeResourceType::COUNT)] =
+	{
+		"uniform buffers", "storage buffers", "staging buffers", "device memory", "image views", "descriptor pools"
+	};
+
+	ComputeMemoryScope::ComputeMemoryScope(const string& owner)
+	{
+		_previous = CurrentOwner;
+		CurrentOwner = owner;
+	}
+
+	ComputeMemoryScope::~ComputeMemoryScope()
+	{
+		CurrentOwner = _previous;
+	}
+
+	shared_ptr<ComputeMemoryStats> ComputeMemoryStats::Get()
+	{
+		static shared_ptr<ComputeMemoryStats> stats = make_shared<ComputeMemoryStats>();
+		return stats;
+	}
+
+	void ComputeMemoryStats::init()
+	{
+		if (_initialized)
+		{
+			return;
+		}
+		_initialized = true;
+
+		VkPhysicalDevice physicalDevice = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device->physicaldevice;
+		VkPhysicalDeviceMemoryProperties properties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties);
+		_heaps.resize(properties.memoryHeapCount);
+		_warned.assign(properties.memoryHeapCount, false);
+		for (uint32_t i = 0; i < properties.memoryHeapCount; i++)
+		{
+			_heaps[i].size = properties.memoryHeaps[i].size;
+			_heaps[i].deviceLocal = (properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+			_heaps[i].budget = _heaps[i].size;
+		}
+
+		uint32_t count = 0;
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, nullptr);
+		vector<VkExtensionProperties> extensions(count);
+		vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, extensions.data());
+		for (auto& extension : extensions)
+		{
+			if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+			{
+				_budgetSupported = true;
+			}
+		}
+	}
+
+	int ComputeMemoryStats::GetHeap(uint32_t memoryTypeIndex)
+	{
+		VkPhysicalDevice physicalDevice = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device->physicaldevice;
+		VkPhysicalDeviceMemoryProperties properties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties);
+		return memoryTypeIndex < properties.memoryTypeCount ? int(properties.memoryTypes[memoryTypeIndex].heapIndex) : -1;
+	}
+
+	void ComputeMemoryStats::Track(uint64_t handle, ComputeResourceType type, VkDeviceSize bytes, int heap)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		init();
+
+		Record record = { type, heap, bytes, CurrentOwner.empty() ? "other" : CurrentOwner };
+		_types[int(type)].bytes += bytes;
+		_types[int(type)].count++;
+		_owners[record.owner].bytes += bytes;
+		_owners[record.owner].count++;
+		if (heap >= 0 && heap < _heaps.size())
+		{
+			_heaps[heap].compute.bytes += bytes;
+			_heaps[heap].compute.count++;
+			checkBudget(heap);
+		}
+		_records[handle] = record;
+	}
+
+	void ComputeMemoryStats::Untrack(uint64_t handle)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto it = _records.find(handle);
+		if (it == _records.end())
+		{
+			return;
+		}
+
+		auto& record = it->second;
+		_types[int(record.type)].bytes -= record.bytes;
+		_types[int(record.type)].count--;
+		auto& owner = _owners[record.owner];
+		owner.bytes -= record.bytes;
+		owner.count--;
+		if (owner.count == 0)
+		{
+			_owners.erase(record.owner);
+		}
+		if (record.heap >= 0 && record.heap < _heaps.size())
+		{
+			_heaps[record.heap].compute.bytes -= record.bytes;
+			_heaps[record.heap].compute.count--;
+		}
+		_records.erase(it);
+	}
+
+	void ComputeMemoryStats::Update()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		init();
+		if (!_budgetSupported)
+		{
+			for (int i = 0; i < _heaps.size(); i++)
+			{
+				_heaps[i].usage = _heaps[i].compute.bytes;
+			}
+			return;
+		}
+
+		VkPhysicalDevice physicalDevice = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device->physicaldevice;
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+		budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		properties.pNext = &budget;
+		vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+
+		for (int i = 0; i < _heaps.size(); i++)
+		{
+			_heaps[i].budget = budget.heapBudget[i];
+			_heaps[i].usage = budget.heapUsage[i];
+			checkBudget(i);
+		}
+	}
+
+	void ComputeMemoryStats::checkBudget(int heap)
+	{
+		auto& stats = _heaps[heap];
+		VkDeviceSize usage = _budgetSupported ? stats.usage : stats.compute.bytes;
+		bool over = stats.budget > 0 && double(usage) >= double(stats.budget) * _warningFraction;
+		if (!over || _warned[heap])
+		{
+			_warned[heap] = over;
+			return;
+		}
+		_warned[heap] = true;
+
+		// the largest owners are the likely culprits
+		vector<pair<string, ComputeMemoryUsage>> owners(_owners.begin(), _owners.end());
+		std::sort(owners.begin(), owners.end(), [](const auto& a, const auto& b) { return a.second.bytes > b.second.bytes; });
+
+		string message = "Warning: memory heap " + std::to_string(heap) + " uses " + std::to_string(usage / (1024 * 1024)) + " of "
+			+ std::to_string(stats.budget / (1024 * 1024)) + " MB, compute layer " + std::to_string(stats.compute.bytes / (1024 * 1024)) + " MB, largest owners:";
+		for (int i = 0; i < owners.size() && i < 3; i++)
+		{
+			message += " " + owners[i].first + " (" + std::to_string(owners[i].second.bytes / 1024) + " KB)";
+		}
+		Print(message);
+	}
+
+	vector<ComputeHeapStats> ComputeMemoryStats::GetHeaps()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		init();
+		return _heaps;
+	}
+
+	ComputeMemoryUsage ComputeMemoryStats::GetUsage(ComputeResourceType type)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _types[int(type)];
+	}
+
+	std::map<string, ComputeMemoryUsage> ComputeMemoryStats::GetOwners()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _owners;
+	}
+
+	string ComputeMemoryStats::GetReport()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		init();
+
+		string report;
+		for (int i = 0; i < _heaps.size(); i++)
+		{
+			report += "heap " + std::to_string(i) + (_heaps[i].deviceLocal ? " (device local)" : "") + ": compute "
+				+ std::to_string(_heaps[i].compute.bytes / 1024) + " KB in " + std::to_string(_heaps[i].compute.count) + " allocations, usage "
+				+ std::to_string(_heaps[i].usage / (1024 * 1024)) + " of " + std::to_string(_heaps[i].budget / (1024 * 1024)) + " MB\n";
+		}
+		for (int i = 0; i < int(ComputeResourceType::COUNT); i++)
+		{
+			report += string(ResourceTypeNames[i]) + ": " + std::to_string(_types[i].count) + ", " + std::to_string(_types[i].bytes / 1024) + " KB\n";
+		}
+		for (auto& owner : _owners)
+		{
+			report += owner.first + ": " + std::to_string(owner.second.count) + " objects, " + std::to_string(owner.second.bytes / 1024) + " KB\n";
+		}
+		return report;
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "UltraEngine.h"
+#include <map>
+#include <mutex>
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	enum class ComputeResourceType
+	{
+		UNIFORM_BUFFER,
+		STORAGE_BUFFER,
+		STAGING_BUFFER,
+		// memory allocated without a buffer of its own, e.g. the transient heap of a ComputeGraph
+		DEVICE_MEMORY,
+		IMAGE_VIEW,
+		DESCRIPTOR_POOL,
+		COUNT
+	};
+
+	struct ComputeMemoryUsage
+	{
+		uint64_t bytes = 0;
+		uint64_t count = 0;
+	};
+
+	struct ComputeHeapStats
+	{
+		VkDeviceSize size = 0;
+		bool deviceLocal = false;
+		// allocations of the compute layer
+		ComputeMemoryUsage compute;
+		// with VK_EXT_memory_budget the budget and usage of the whole process, otherwise the heap size and the compute usage
+		VkDeviceSize budget = 0;
+		VkDeviceSize usage = 0;
+	};
+
+	/// <summary>
+	/// Attributes the objects created on this thread while the scope lives to the owner, e.g. the name of a ComputeShader.
+	/// </summary>
+	class ComputeMemoryScope
+	{
+	private:
+		string _previous;
+
+	public:
+		ComputeMemoryScope(const string& owner);
+		~ComputeMemoryScope();
+	};
+
+	/// <summary>
+	/// Accounts for the memory and the Vulkan objects held by the compute layer, per heap, per resource type and per owner.
+	/// Objects are tracked by their handle where they are created and released. Once per frame the budget of the heaps is
+	/// refreshed from VK_EXT_memory_budget if the device supports it, and a warning names the largest owners when a heap
+	/// crosses the warning fraction of its budget.
+	/// </summary>
+	class ComputeMemoryStats : public Object
+	{
+	private:
+		struct Record
+		{
+			ComputeResourceType type;
+			int heap;
+			VkDeviceSize bytes;
+			string owner;
+		};
+
+		std::mutex _mutex;
+		std::map<uint64_t, Record> _records;
+		ComputeMemoryUsage _types[int(ComputeResourceType::COUNT)];
+		std::map<string, ComputeMemoryUsage> _owners;
+		vector<ComputeHeapStats> _heaps;
+		vector<bool> _warned;
+		float _warningFraction = 0.9f;
+		bool _budgetSupported = false;
+		bool _initialized = false;
+
+		void init();
+		void checkBudget(int heap);
+
+	public:
+		static shared_ptr<ComputeMemoryStats> Get();
+
+		// Heap of a memory type, for the heap argument of Track
+		int GetHeap(uint32_t memoryTypeIndex);
+		void Track(uint64_t handle, ComputeResourceType type, VkDeviceSize bytes = 0, int heap = -1);
+		void Untrack(uint64_t handle);
+
+		// Refreshes the budgets, called by ComputeContext once per frame
+		void Update();
+		// Fraction of a heap's budget from which a warning is printed, once until the usage drops below it again
+		void SetWarningFraction(float fraction) { _warningFraction = fraction; }
+		bool IsBudgetSupported() const { return _budgetSupported; }
+
+		vector<ComputeHeapStats> GetHeaps();
+		ComputeMemoryUsage GetUsage(ComputeResourceType type);
+		// Objects created outside of an owner scope are listed as "other"
+		std::map<string, ComputeMemoryUsage> GetOwners();
+		// One line per heap, resource type and owner
+		string GetReport();
+	};
+}
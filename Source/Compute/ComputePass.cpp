@@ -0,0 +1,117 @@
+#include "UltraEngine.h"
+#include "ComputePass.h"
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	void RecordComputePasses(const UltraEngine::Render::VkRenderer& renderer, shared_ptr<Object> extra)
+	{
+		auto passes = extra->As<ComputePassList>();
+		if (passes != nullptr)
+		{
+			passes->Record(renderer.commandbuffer);
+			if (passes->GetCompletion() != nullptr)
+			{
+				passes->GetCompletion()->Signal();
+			}
+		}
+	}
+
+	ComputePassList::ComputePassList()
+	{
+		_timestampQuery = make_shared<TimeStampQuery>();
+	}
+
+	shared_ptr<ComputePassList> ComputePassList::Create()
+	{
+		return make_shared<ComputePassList>();
+	}
+
+	void ComputePassList::Add(shared_ptr<ComputeShader> shader, int tx, int ty, int tz, const void* pushData, size_t pushDataSize)
+	{
+		ComputePass pass;
+		pass.shader = shader;
+		pass.tx = tx;
+		pass.ty = ty;
+		pass.tz = tz;
+		pass.pushConstantsSize = std::min(pushDataSize, sizeof(pass.pushConstants));
+		if (pushData != nullptr)
+		{
+			memcpy(pass.pushConstants, pushData, pass.pushConstantsSize);
+		}
+		_passes.push_back(pass);
+	}
+
+	void ComputePassList::AddIndirect(shared_ptr<ComputeShader> shader, shared_ptr<ComputeStorageBuffer> buffer, size_t offset, const void* pushData, size_t pushDataSize)
+	{
+		Add(shader, 0, 0, 0, pushData, pushDataSize);
+		_passes.back().indirectBuffer = buffer;
+		_passes.back().indirectOffset = offset;
+	}
+
+	shared_ptr<ComputeCompletion> ComputePassList::BeginDispatch(shared_ptr<World> world, ComputeHook hook)
+	{
+		_completion = ComputeCompletion::Create();
+
+		if (ComputeShader::DescriptorPool == nullptr)
+		{
+			ComputeShader::DescriptorPool = make_shared<ComputeDescriptorPool>(world);
+		}
+
+		ComputeContext::Get()->Attach(world);
+		switch (hook)
+		{
+		case ComputeHook::RENDER:
+			world->AddHook(HookID::HOOKID_RENDER, RecordComputePasses, Self(), false);
+			break;
+		case ComputeHook::TRANSFER:
+			world->AddHook(HookID::HOOKID_TRANSFER, RecordComputePasses, Self(), false);
+			break;
+		}
+		return _completion;
+	}
+
+	void ComputePassList::Record(VkCommandBuffer commandBuffer)
+	{
+		auto manager = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager;
+		_timestampQuery->Init(manager->device->physicaldevice, manager->device->device);
+		_timestampQuery->Reset(commandBuffer);
+		_timestampQuery->write(commandBuffer, 0);
+
+		VkMemoryBarrier memoryBarrier = initializers::memoryBarrier();
+		memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+		for (auto& pass : _passes)
+		{
+			void* pushData = pass.pushConstantsSize > 0 ? pass.pushConstants : nullptr;
+			if (pass.indirectBuffer != nullptr)
+			{
+				pass.shader->DispatchIndirect(commandBuffer, pass.indirectBuffer->GetBuffer().buffer, pass.indirectOffset, pushData, pass.pushConstantsSize, 0);
+			}
+			else
+			{
+				pass.shader->Dispatch(commandBuffer, pass.tx, pass.ty, pass.tz, pushData, pass.pushConstantsSize, 0);
+			}
+
+			// later passes may take their group counts from buffers written by this one
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+		}
+
+		_timestampQuery->write(commandBuffer, 1);
+
+		// the results may be read by any later work or mapped by the host once the frame has completed
+		memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void GetDispatchGrid(uint32_t groups, int& tx, int& ty)
+	{
+		const uint32_t maxGroups = 32768;
+		tx = std::max(1u, std::min(groups, maxGroups));
+		ty = (groups + tx - 1) / tx;
+		ty = std::max(ty, 1);
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "UltraEngine.h"
+#include "ComputeShader.h"
+#include "ComputeStorageBuffer.h"
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	void RecordComputePasses(const UltraEngine::Render::VkRenderer& renderer, shared_ptr<Object> extra);
+
+	struct ComputePass
+	{
+		shared_ptr<ComputeShader> shader;
+		int tx;
+		int ty;
+		int tz;
+		// group counts written by an earlier pass, used instead of tx, ty and tz
+		shared_ptr<ComputeStorageBuffer> indirectBuffer;
+		size_t indirectOffset = 0;
+		uint8_t pushConstants[128];
+		size_t pushConstantsSize = 0;
+	};
+
+	/// <summary>
+	/// Dispatches recorded back to back in a single hook, each one followed by a barrier which makes its shader writes
+	/// visible to the next pass. Used by multi-pass algorithms like the scan, where every pass depends on the previous one.
+	/// The list is consumed on the rendering thread, build a new one instead of changing a submitted list.
+	/// </summary>
+	class ComputePassList : public Object
+	{
+	private:
+		vector<ComputePass> _passes;
+		shared_ptr<TimeStampQuery> _timestampQuery;
+		shared_ptr<ComputeCompletion> _completion;
+
+	public:
+		ComputePassList();
+		static shared_ptr<ComputePassList> Create();
+
+		// Push constants are copied, up to 128 bytes
+		void Add(shared_ptr<ComputeShader> shader, int tx, int ty, int tz, const void* pushData = nullptr, size_t pushDataSize = 0);
+		// Takes the group counts from a VkDispatchIndirectCommand in the buffer, which may be written by an earlier pass of the list
+		void AddIndirect(shared_ptr<ComputeShader> shader, shared_ptr<ComputeStorageBuffer> buffer, size_t offset, const void* pushData = nullptr, size_t pushDataSize = 0);
+		size_t CountPasses() const { return _passes.size(); }
+
+		// Submits the passes once, the handle completes when the GPU has executed all of them
+		shared_ptr<ComputeCompletion> BeginDispatch(shared_ptr<World> world, ComputeHook hook = ComputeHook::TRANSFER);
+		// Handle of the last BeginDispatch, e.g. for the passes of a ComputeSort
+		shared_ptr<ComputeCompletion> GetCompletion() const { return _completion; }
+		void Record(VkCommandBuffer commandBuffer);
+
+		// Start and end of the whole list
+		shared_ptr<TimeStampQuery> GetQueryTimer() { return _timestampQuery; }
+	};
+
+	// Splits a large number of workgroups into a 2D grid below the guaranteed limit of 65535 per dimension.
+	// Shaders compute the linear group index as gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x and skip the excess groups.
+	void GetDispatchGrid(uint32_t groups, int& tx, int& ty);
+}
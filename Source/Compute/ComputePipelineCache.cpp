@@ -0,0 +1,211 @@
+#include "UltraEngine.h"
+#include "ComputePipelineCache.h"
+#include "ComputeBindlessHeap.h"
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	template <typename T>
+	static void appendKey(string& key, const T& value)
+	{
+		key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	ComputeLayoutState::~ComputeLayoutState()
+	{
+		auto context = ComputeContext::Get();
+		context->Retire(pipelineLayout);
+		context->Retire(setLayout);
+	}
+
+	ComputePipelineState::~ComputePipelineState()
+	{
+		ComputeContext::Get()->Retire(pipeline);
+	}
+
+	shared_ptr<ComputePipelineCache> ComputePipelineCache::Get()
+	{
+		static shared_ptr<ComputePipelineCache> cache = make_shared<ComputePipelineCache>();
+		return cache;
+	}
+
+	uint64_t ComputePipelineCache::Hash(const void* data, size_t size)
+	{
+		auto bytes = static_cast<const uint8_t*>(data);
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	string ComputePipelineCache::CodeKey(const void* data, size_t size)
+	{
+		return "spirv:" + std::to_string(Hash(data, size)) + ":" + std::to_string(size / sizeof(uint32_t));
+	}
+
+	static string readCodeKey(const WString& path)
+	{
+		std::ifstream file(std::filesystem::path(std::wstring(path)), std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			return "";
+		}
+
+		size_t size = file.tellg();
+		if (size == 0 || size % sizeof(uint32_t) != 0)
+		{
+			return "";
+		}
+
+		vector<char> code(size);
+		file.seekg(0);
+		file.read(code.data(), size);
+		if (!file.good())
+		{
+			return "";
+		}
+		return ComputePipelineCache::CodeKey(code.data(), size);
+	}
+
+	void ComputePipelineCache::prune()
+	{
+		// entries of states no shader uses any more, only checked when a new one is added
+		for (auto it = _layouts.begin(); it != _layouts.end();)
+		{
+			it = it->second.expired() ? _layouts.erase(it) : std::next(it);
+		}
+		for (auto it = _pipelines.begin(); it != _pipelines.end();)
+		{
+			it = it->second.expired() ? _pipelines.erase(it) : std::next(it);
+		}
+		for (auto it = _modules.begin(); it != _modules.end();)
+		{
+			if (it->second.expired())
+			{
+				_moduleKeys.erase(it->first);
+				it = _modules.erase(it);
+			}
+			else
+			{
+				it = std::next(it);
+			}
+		}
+	}
+
+	shared_ptr<ShaderModule> ComputePipelineCache::LoadModule(const WString& path, string* codeKey)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto module = _modules[path].lock();
+		if (module == nullptr)
+		{
+			prune();
+			module = LoadShaderModule(path);
+			_modules[path] = module;
+			// read once per load, the instances of a shader share the key
+			_moduleKeys[path] = module != nullptr ? readCodeKey(path) : "";
+		}
+		if (codeKey != nullptr)
+		{
+			*codeKey = _moduleKeys[path];
+		}
+		return module;
+	}
+
+	shared_ptr<ComputeLayoutState> ComputePipelineCache::GetLayout(VkDevice device, const vector<VkDescriptorSetLayoutBinding>& bindings, bool bindless, const VkPushConstantRange* pushConstants)
+	{
+		string key;
+		for (auto& binding : bindings)
+		{
+			appendKey(key, binding.binding);
+			appendKey(key, binding.descriptorType);
+			appendKey(key, binding.descriptorCount);
+		}
+		appendKey(key, bindless);
+		appendKey(key, pushConstants != nullptr ? pushConstants->size : 0u);
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto layout = _layouts[key].lock();
+		if (layout != nullptr)
+		{
+			return layout;
+		}
+
+		prune();
+		layout = make_shared<ComputeLayoutState>();
+		VkDescriptorSetLayoutCreateInfo descriptorLayout = initializers::descriptorSetLayoutCreateInfo(bindings);
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &layout->setLayout));
+
+		// bindless shaders address the heap as set 0 and their own bindings, if any, as set 1
+		vector<VkDescriptorSetLayout> setLayouts;
+		if (bindless)
+		{
+			setLayouts.push_back(ComputeBindlessHeap::Get()->GetLayout(device));
+		}
+		if (!bindless || !bindings.empty())
+		{
+			setLayouts.push_back(layout->setLayout);
+		}
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo = initializers::pipelineLayoutCreateInfo(setLayouts.data(), setLayouts.size());
+		if (pushConstants != nullptr)
+		{
+			pipelineLayoutInfo.pPushConstantRanges = pushConstants;
+			pipelineLayoutInfo.pushConstantRangeCount = 1;
+		}
+		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &layout->pipelineLayout));
+
+		_layouts[key] = layout;
+		return layout;
+	}
+
+	shared_ptr<ComputePipelineState> ComputePipelineCache::GetPipeline(const string& codeKey, shared_ptr<ComputeLayoutState> layout, std::function<VkResult(VkPipelineLayout, VkPipeline*)> compile)
+	{
+		string key = codeKey;
+		appendKey(key, layout->pipelineLayout);
+
+		shared_ptr<ComputePipelineState> state;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			state = _pipelines[key].lock();
+			if (state == nullptr)
+			{
+				prune();
+				state = make_shared<ComputePipelineState>();
+				state->layout = layout;
+				_pipelines[key] = state;
+			}
+			else
+			{
+				_hits++;
+			}
+		}
+
+		// outside the lock, other pipelines compile meanwhile
+		std::call_once(state->compiled, [&]()
+			{
+				_compiles++;
+				VkResult result = compile(layout->pipelineLayout, &state->pipeline);
+				if (result != VK_SUCCESS)
+				{
+					Print("Error: Failed to create compute pipeline: " + tools::errorString(result));
+					state->pipeline = VK_NULL_HANDLE;
+				}
+			});
+
+		if (state->pipeline == VK_NULL_HANDLE)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_pipelines[key].lock() == state)
+			{
+				_pipelines.erase(key);
+			}
+			return nullptr;
+		}
+		return state;
+	}
+}
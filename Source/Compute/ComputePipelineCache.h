@@ -0,0 +1,80 @@
+#pragma once
+#include "UltraEngine.h"
+#include "VulkanUtils.h"
+#include "ComputeContext.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	/// <summary>
+	/// Descriptor set layout and pipeline layout shared by the shaders with the same bindings and push constants.
+	/// </summary>
+	class ComputeLayoutState : public Object
+	{
+	public:
+		VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+
+		~ComputeLayoutState();
+	};
+
+	/// <summary>
+	/// Pipeline shared by the shaders with the same code, specialization and layout.
+	/// </summary>
+	class ComputePipelineState : public Object
+	{
+	public:
+		shared_ptr<ComputeLayoutState> layout;
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		std::once_flag compiled;
+
+		~ComputePipelineState();
+	};
+
+	/// <summary>
+	/// Shares everything but the descriptor sets between the instances of a shader. Layouts are looked up by their
+	/// bindings and push constant range, pipelines by the hash of the SPIR-V (read from the file for shaders loaded from
+	/// one), the specialization constants and the layout, so spawning many instances of an effect compiles one pipeline.
+	/// The cache holds weak references, states are destroyed once the last shader using them is gone.
+	/// Thread safe, a pipeline requested from several threads at once is compiled by the first and waited for by the others.
+	/// </summary>
+	class ComputePipelineCache : public Object
+	{
+	private:
+		std::mutex _mutex;
+		std::map<string, weak_ptr<ComputeLayoutState>> _layouts;
+		std::map<string, weak_ptr<ComputePipelineState>> _pipelines;
+		std::map<WString, weak_ptr<ShaderModule>> _modules;
+		std::map<WString, string> _moduleKeys;
+		std::atomic<uint64_t> _compiles = 0;
+		std::atomic<uint64_t> _hits = 0;
+
+		void prune();
+
+	public:
+		static shared_ptr<ComputePipelineCache> Get();
+
+		// FNV-1a, used for the SPIR-V part of the pipeline keys
+		static uint64_t Hash(const void* data, size_t size);
+		// Identifies SPIR-V by its content, the same code gets the same key wherever it came from
+		static string CodeKey(const void* data, size_t size);
+
+		// Loads each shader file once while any shader uses it. codeKey receives the CodeKey of the file's content, or an
+		// empty string if the file could not be read directly (e.g. from a package).
+		shared_ptr<ShaderModule> LoadModule(const WString& path, string* codeKey = nullptr);
+		shared_ptr<ComputeLayoutState> GetLayout(VkDevice device, const vector<VkDescriptorSetLayoutBinding>& bindings, bool bindless, const VkPushConstantRange* pushConstants);
+		// codeKey identifies the code and specialization, compile is only called if no shader with the same key and layout
+		// exists. Returns nullptr if compiling failed.
+		shared_ptr<ComputePipelineState> GetPipeline(const string& codeKey, shared_ptr<ComputeLayoutState> layout, std::function<VkResult(VkPipelineLayout, VkPipeline*)> compile);
+
+		uint64_t CountCompiles() const { return _compiles; }
+		uint64_t CountHits() const { return _hits; }
+	};
+}
@@ -0,0 +1,64 @@
+#include "UltraEngine.h"
+#include "ComputePipelineCompiler.h"
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	ComputePipelineCompiler::ComputePipelineCompiler()
+	{
+		_running = true;
+		_thread = std::thread(&ComputePipelineCompiler::run, this);
+	}
+
+	ComputePipelineCompiler::~ComputePipelineCompiler()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_running = false;
+		}
+		_condition.notify_all();
+		if (_thread.joinable())
+		{
+			_thread.join();
+		}
+	}
+
+	shared_ptr<ComputePipelineCompiler> ComputePipelineCompiler::Get()
+	{
+		static shared_ptr<ComputePipelineCompiler> compiler = make_shared<ComputePipelineCompiler>();
+		return compiler;
+	}
+
+	void ComputePipelineCompiler::Submit(std::function<void()> job)
+	{
+		_pending++;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_jobs.push_back(std::move(job));
+		}
+		_condition.notify_one();
+	}
+
+	void ComputePipelineCompiler::run()
+	{
+		while (true)
+		{
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_condition.wait(lock, [this]() { return !_running || !_jobs.empty(); });
+				if (!_running)
+				{
+					return;
+				}
+				job = std::move(_jobs.front());
+				_jobs.pop_front();
+			}
+
+			job();
+			_pending--;
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include "UltraEngine.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	/// <summary>
+	/// Worker thread which builds the layouts and pipelines of compute shaders ahead of their first dispatch, so the
+	/// rendering thread never waits for vkCreateComputePipelines. Jobs run one after the other in the order they were queued.
+	/// See ComputeShader::Precompile.
+	/// </summary>
+	class ComputePipelineCompiler : public Object
+	{
+	private:
+		std::mutex _mutex;
+		std::condition_variable _condition;
+		std::deque<std::function<void()>> _jobs;
+		std::thread _thread;
+		std::atomic<bool> _running;
+		std::atomic<int> _pending = 0;
+
+		void run();
+
+	public:
+		ComputePipelineCompiler();
+		virtual ~ComputePipelineCompiler();
+
+		static shared_ptr<ComputePipelineCompiler> Get();
+
+		void Submit(std::function<void()> job);
+		// Jobs queued or running
+		int CountPending() const { return _pending; }
+	};
+}
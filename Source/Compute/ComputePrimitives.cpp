@@ -0,0 +1,265 @@
+#include "UltraEngine.h"
+#include "ComputePrimitives.h"
+#include "Generated/EmbeddedShaders.h"
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	// must match Shaders/Compute/primitives.comp
+	enum PrimitiveMode
+	{
+		PRIMITIVE_MODE_REDUCE = 0,
+		PRIMITIVE_MODE_SCAN = 1
+	};
+
+	enum PrimitiveFlags
+	{
+		PRIMITIVE_FLAG_SOURCE_INPUT = 1,
+		PRIMITIVE_FLAG_DEST_OUTPUT = 2,
+		PRIMITIVE_FLAG_INCLUSIVE = 4,
+		PRIMITIVE_FLAG_PREDICATE = 8,
+		PRIMITIVE_FLAG_OFFSETS = 16,
+		PRIMITIVE_FLAG_RESULT = 32
+	};
+
+	ComputePrimitive::ComputePrimitive(shared_ptr<ComputeStorageBuffer> input, shared_ptr<ComputeStorageBuffer> output, uint32_t maxCount)
+	{
+		_maxCount = maxCount;
+		_input = input;
+		_results = ComputeStorageBuffer::Create(4 * sizeof(uint32_t));
+		// the reduction has no output, the binding still needs a buffer
+		_output = output != nullptr ? output : _results;
+
+		auto levels = getLevels(maxCount);
+		_levelOffsets.resize(levels.size(), 0);
+		uint32_t scratchSize = 0;
+		for (int level = 1; level < levels.size(); level++)
+		{
+			_levelOffsets[level] = scratchSize;
+			scratchSize += levels[level];
+		}
+		_scratch = ComputeStorageBuffer::Create(std::max(scratchSize, 1u) * sizeof(uint32_t));
+
+		_shader = ComputeShader::CreateFromMemory(EmbeddedShaders::primitives, sizeof(EmbeddedShaders::primitives));
+		_shader->AddStorageBuffer(_input);
+		_shader->AddStorageBuffer(_output);
+		_shader->AddStorageBuffer(_scratch);
+		_shader->AddStorageBuffer(_results);
+		_shader->SetupPushConstant(sizeof(ComputePrimitiveConstants));
+	}
+
+	vector<uint32_t> ComputePrimitive::getLevels(uint32_t count) const
+	{
+		vector<uint32_t> levels = { count };
+		while (levels.back() > BLOCK_SIZE)
+		{
+			levels.push_back((levels.back() + BLOCK_SIZE - 1) / BLOCK_SIZE);
+		}
+		return levels;
+	}
+
+	void ComputePrimitive::addPass(shared_ptr<ComputePassList> passes, const ComputePrimitiveConstants& constants, uint32_t groups)
+	{
+		int tx, ty;
+		GetDispatchGrid(groups, tx, ty);
+		passes->Add(_shader, tx, ty, 1, &constants, sizeof(ComputePrimitiveConstants));
+	}
+
+	void ComputePrimitive::addReducePasses(shared_ptr<ComputePassList> passes, ComputePrimitiveConstants constants, const vector<uint32_t>& levels)
+	{
+		uint32_t levelFlags = constants.flags;
+		constants.mode = PRIMITIVE_MODE_REDUCE;
+
+		for (int level = 0; level < levels.size(); level++)
+		{
+			constants.count = levels[level];
+			constants.flags = level == 0 ? levelFlags | PRIMITIVE_FLAG_SOURCE_INPUT : 0;
+			constants.srcOffset = _levelOffsets[level];
+
+			if (level == levels.size() - 1)
+			{
+				constants.flags |= PRIMITIVE_FLAG_RESULT;
+			}
+			else
+			{
+				constants.dstOffset = _levelOffsets[level + 1];
+			}
+
+			addPass(passes, constants, (levels[level] + BLOCK_SIZE - 1) / BLOCK_SIZE);
+
+			// predicates and the element type only apply to the input, the upper levels hold counts
+			if (levelFlags & PRIMITIVE_FLAG_PREDICATE)
+			{
+				constants.type = uint32_t(ComputeDataType::UINT);
+			}
+		}
+	}
+
+	void ComputePrimitive::addScanPasses(shared_ptr<ComputePassList> passes, ComputePrimitiveConstants constants, const vector<uint32_t>& levels, bool inclusive)
+	{
+		uint32_t inputType = constants.type;
+		uint32_t levelFlags = constants.flags;
+		bool predicate = (levelFlags & PRIMITIVE_FLAG_PREDICATE) != 0;
+
+		// block results of every level except the top one
+		constants.mode = PRIMITIVE_MODE_REDUCE;
+		for (int level = 0; level < int(levels.size()) - 1; level++)
+		{
+			constants.count = levels[level];
+			constants.flags = level == 0 ? levelFlags | PRIMITIVE_FLAG_SOURCE_INPUT : 0;
+			constants.type = level == 0 || !predicate ? inputType : uint32_t(ComputeDataType::UINT);
+			constants.srcOffset = _levelOffsets[level];
+			constants.dstOffset = _levelOffsets[level + 1];
+			addPass(passes, constants, (levels[level] + BLOCK_SIZE - 1) / BLOCK_SIZE);
+		}
+
+		// the upper levels are scanned exclusively in place and become the block offsets of the level below
+		constants.mode = PRIMITIVE_MODE_SCAN;
+		for (int level = levels.size() - 1; level >= 0; level--)
+		{
+			constants.count = levels[level];
+			constants.type = level == 0 || !predicate ? inputType : uint32_t(ComputeDataType::UINT);
+			constants.srcOffset = _levelOffsets[level];
+			constants.dstOffset = _levelOffsets[level];
+
+			if (level == 0)
+			{
+				constants.flags = levelFlags | PRIMITIVE_FLAG_SOURCE_INPUT | PRIMITIVE_FLAG_DEST_OUTPUT;
+				if (inclusive)
+				{
+					constants.flags |= PRIMITIVE_FLAG_INCLUSIVE;
+				}
+			}
+			else
+			{
+				constants.flags = 0;
+			}
+
+			if (level < levels.size() - 1)
+			{
+				constants.flags |= PRIMITIVE_FLAG_OFFSETS;
+				constants.offsetsOffset = _levelOffsets[level + 1];
+			}
+			else
+			{
+				constants.flags |= PRIMITIVE_FLAG_RESULT;
+			}
+
+			addPass(passes, constants, (levels[level] + BLOCK_SIZE - 1) / BLOCK_SIZE);
+		}
+	}
+
+	void ComputePrimitive::submit(shared_ptr<World> world, shared_ptr<ComputePassList> passes, ComputeHook hook)
+	{
+		_lastPasses = passes;
+		passes->BeginDispatch(world, hook);
+	}
+
+	ComputeScan::ComputeScan(shared_ptr<ComputeStorageBuffer> input, shared_ptr<ComputeStorageBuffer> output, uint32_t maxCount, ComputeDataType type, ComputeReduceOp op)
+		: ComputePrimitive(input, output, maxCount)
+	{
+		_type = type;
+		_op = op;
+	}
+
+	shared_ptr<ComputeScan> ComputeScan::Create(shared_ptr<ComputeStorageBuffer> input, shared_ptr<ComputeStorageBuffer> output, uint32_t maxCount, ComputeDataType type, ComputeReduceOp op)
+	{
+		return make_shared<ComputeScan>(input, output, maxCount, type, op);
+	}
+
+	void ComputeScan::Dispatch(shared_ptr<World> world, uint32_t count, bool inclusive, ComputeHook hook)
+	{
+		auto passes = ComputePassList::Create();
+		AddPasses(passes, count, inclusive);
+		if (passes->CountPasses() > 0)
+		{
+			submit(world, passes, hook);
+		}
+	}
+
+	void ComputeScan::AddPasses(shared_ptr<ComputePassList> passes, uint32_t count, bool inclusive)
+	{
+		count = std::min(count, _maxCount);
+		if (count == 0)
+		{
+			return;
+		}
+
+		ComputePrimitiveConstants constants = {};
+		constants.op = uint32_t(_op);
+		constants.type = uint32_t(_type);
+		addScanPasses(passes, constants, getLevels(count), inclusive);
+	}
+
+	ComputeReduce::ComputeReduce(shared_ptr<ComputeStorageBuffer> input, uint32_t maxCount, ComputeDataType type, ComputeReduceOp op)
+		: ComputePrimitive(input, nullptr, maxCount)
+	{
+		_type = type;
+		_op = op;
+	}
+
+	shared_ptr<ComputeReduce> ComputeReduce::Create(shared_ptr<ComputeStorageBuffer> input, uint32_t maxCount, ComputeDataType type, ComputeReduceOp op)
+	{
+		return make_shared<ComputeReduce>(input, maxCount, type, op);
+	}
+
+	void ComputeReduce::Dispatch(shared_ptr<World> world, uint32_t count, ComputeHook hook)
+	{
+		count = std::min(count, _maxCount);
+		if (count == 0)
+		{
+			return;
+		}
+
+		ComputePrimitiveConstants constants = {};
+		constants.op = uint32_t(_op);
+		constants.type = uint32_t(_type);
+
+		auto passes = ComputePassList::Create();
+		addReducePasses(passes, constants, getLevels(count));
+		submit(world, passes, hook);
+	}
+
+	ComputeCompact::ComputeCompact(shared_ptr<ComputeStorageBuffer> input, shared_ptr<ComputeStorageBuffer> output, uint32_t maxCount, ComputeDataType type)
+		: ComputePrimitive(input, output, maxCount)
+	{
+		_type = type;
+	}
+
+	shared_ptr<ComputeCompact> ComputeCompact::Create(shared_ptr<ComputeStorageBuffer> input, shared_ptr<ComputeStorageBuffer> output, uint32_t maxCount, ComputeDataType type)
+	{
+		return make_shared<ComputeCompact>(input, output, maxCount, type);
+	}
+
+	void ComputeCompact::dispatch(shared_ptr<World> world, uint32_t count, ComputePredicate predicate, uint32_t valueBits, ComputeHook hook)
+	{
+		count = std::min(count, _maxCount);
+		if (count == 0)
+		{
+			uint32_t zero = 0;
+			_results->SetData(&zero, sizeof(zero));
+			return;
+		}
+
+		// an exclusive scan of the predicate flags is the position of every selected element
+		ComputePrimitiveConstants constants = {};
+		constants.op = uint32_t(ComputeReduceOp::SUM);
+		constants.type = uint32_t(_type);
+		constants.flags = PRIMITIVE_FLAG_PREDICATE;
+		constants.predicateOp = uint32_t(predicate);
+		constants.predicateValue = valueBits;
+
+		auto passes = ComputePassList::Create();
+		addScanPasses(passes, constants, getLevels(count), false);
+		submit(world, passes, hook);
+	}
+
+	uint32_t ComputeCompact::GetCount()
+	{
+		uint32_t count;
+		_results->GetData(&count, sizeof(count));
+		return count;
+	}
+}
@@ -0,0 +1,160 @@
+#pragma once
+#include "UltraEngine.h"
+#include "ComputeShader.h"
+#include "ComputePass.h"
+#include "ComputeStorageBuffer.h"
+#include <cstring>
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	enum class ComputeDataType
+	{
+		UINT = 0,
+		INT = 1,
+		FLOAT = 2
+	};
+
+	enum class ComputeReduceOp
+	{
+		SUM = 0,
+		MIN = 1,
+		MAX = 2
+	};
+
+	enum class ComputePredicate
+	{
+		EQUAL = 0,
+		NOT_EQUAL = 1,
+		LESS = 2,
+		GREATER = 3
+	};
+
+	// Push constants of Shaders/Compute/primitives.comp
+	struct ComputePrimitiveConstants
+	{
+		uint32_t mode;
+		uint32_t op;
+		uint32_t type;
+		uint32_t count;
+		uint32_t srcOffset;
+		uint32_t dstOffset;
+		uint32_t offsetsOffset;
+		uint32_t flags;
+		uint32_t predicateOp;
+		uint32_t predicateValue;
+		uint32_t resultIndex;
+	};
+
+	/// <summary>
+	/// Shared part of the scan, reduction and compaction. The elements are processed in blocks of 1024 per workgroup
+	/// using subgroup operations. The block results form the next level, which is processed the same way until a single
+	/// block is left, so each level is 1024 times smaller: three levels cover a billion elements.
+	/// All passes of an operation are recorded in one hook with barriers in between (see ComputePassList).
+	/// </summary>
+	class ComputePrimitive : public Object
+	{
+	protected:
+		shared_ptr<ComputeShader> _shader;
+		shared_ptr<ComputeStorageBuffer> _input;
+		shared_ptr<ComputeStorageBuffer> _output;
+		shared_ptr<ComputeStorageBuffer> _scratch;
+		shared_ptr<ComputeStorageBuffer> _results;
+		uint32_t _maxCount;
+		// Scratch offset of every level, level 0 is the input
+		vector<uint32_t> _levelOffsets;
+		shared_ptr<ComputePassList> _lastPasses;
+
+		ComputePrimitive(shared_ptr<ComputeStorageBuffer> input, shared_ptr<ComputeStorageBuffer> output, uint32_t maxCount);
+
+		vector<uint32_t> getLevels(uint32_t count) const;
+		void addPass(shared_ptr<ComputePassList> passes, const ComputePrimitiveConstants& constants, uint32_t groups);
+		// Reduces level 0 into results[resultIndex]
+		void addReducePasses(shared_ptr<ComputePassList> passes, ComputePrimitiveConstants constants, const vector<uint32_t>& levels);
+		// Reduces the levels bottom up and scans them top down, the total ends up in results[resultIndex]
+		void addScanPasses(shared_ptr<ComputePassList> passes, ComputePrimitiveConstants constants, const vector<uint32_t>& levels, bool inclusive);
+		void submit(shared_ptr<World> world, shared_ptr<ComputePassList> passes, ComputeHook hook);
+
+	public:
+		static constexpr uint32_t BLOCK_SIZE = 1024;
+
+		// Small buffer with the reduction result or the scan total at index 0
+		shared_ptr<ComputeStorageBuffer> GetResultBuffer() { return _results; }
+		// The passes of the last dispatch, their timer measures the whole operation
+		shared_ptr<ComputePassList> GetLastPasses() { return _lastPasses; }
+	};
+
+	/// <summary>
+	/// Inclusive or exclusive prefix sum (or prefix min / max) of up to maxCount elements. The total is written to the result buffer.
+	/// </summary>
+	class ComputeScan : public ComputePrimitive
+	{
+	private:
+		ComputeDataType _type;
+		ComputeReduceOp _op;
+
+	public:
+		ComputeScan(shared_ptr<ComputeStorageBuffer> input, shared_ptr<ComputeStorageBuffer> output, uint32_t maxCount, ComputeDataType type, ComputeReduceOp op);
+		static shared_ptr<ComputeScan> Create(shared_ptr<ComputeStorageBuffer> input, shared_ptr<ComputeStorageBuffer> output, uint32_t maxCount, ComputeDataType type = ComputeDataType::UINT, ComputeReduceOp op = ComputeReduceOp::SUM);
+
+		void Dispatch(shared_ptr<World> world, uint32_t count, bool inclusive = true, ComputeHook hook = ComputeHook::TRANSFER);
+		// Appends the passes of a scan to the list of a larger algorithm, e.g. the histogram scan of ComputeSort
+		void AddPasses(shared_ptr<ComputePassList> passes, uint32_t count, bool inclusive = true);
+	};
+
+	/// <summary>
+	/// Sum, minimum or maximum of up to maxCount elements
+	/// </summary>
+	class ComputeReduce : public ComputePrimitive
+	{
+	private:
+		ComputeDataType _type;
+		ComputeReduceOp _op;
+
+	public:
+		ComputeReduce(shared_ptr<ComputeStorageBuffer> input, uint32_t maxCount, ComputeDataType type, ComputeReduceOp op);
+		static shared_ptr<ComputeReduce> Create(shared_ptr<ComputeStorageBuffer> input, uint32_t maxCount, ComputeDataType type = ComputeDataType::UINT, ComputeReduceOp op = ComputeReduceOp::SUM);
+
+		void Dispatch(shared_ptr<World> world, uint32_t count, ComputeHook hook = ComputeHook::TRANSFER);
+
+		// Reads the result back, valid once the frame of the dispatch has completed
+		template <typename T>
+		T GetResult()
+		{
+			static_assert(sizeof(T) == sizeof(uint32_t), "results are 32 bit");
+			T value;
+			_results->GetData(&value, sizeof(T));
+			return value;
+		}
+	};
+
+	/// <summary>
+	/// Stream compaction: copies the elements which match the predicate to the front of the output, keeping their order.
+	/// The number of copied elements is written to index 0 of the result buffer, which later passes can use as element count.
+	/// </summary>
+	class ComputeCompact : public ComputePrimitive
+	{
+	private:
+		ComputeDataType _type;
+
+		void dispatch(shared_ptr<World> world, uint32_t count, ComputePredicate predicate, uint32_t valueBits, ComputeHook hook);
+
+	public:
+		ComputeCompact(shared_ptr<ComputeStorageBuffer> input, shared_ptr<ComputeStorageBuffer> output, uint32_t maxCount, ComputeDataType type);
+		static shared_ptr<ComputeCompact> Create(shared_ptr<ComputeStorageBuffer> input, shared_ptr<ComputeStorageBuffer> output, uint32_t maxCount, ComputeDataType type = ComputeDataType::UINT);
+
+		// Keeps the elements for which "element predicate value" is true, value has the element type
+		template <typename T>
+		void Dispatch(shared_ptr<World> world, uint32_t count, ComputePredicate predicate, T value, ComputeHook hook = ComputeHook::TRANSFER)
+		{
+			static_assert(sizeof(T) == sizeof(uint32_t), "elements are 32 bit");
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+			dispatch(world, count, predicate, bits, hook);
+		}
+
+		// Reads the number of compacted elements back, valid once the frame of the dispatch has completed
+		uint32_t GetCount();
+	};
+}
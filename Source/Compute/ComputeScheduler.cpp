@@ -0,0 +1,240 @@
+#include "UltraEngine.h"
+#include "ComputeScheduler.h"
+#include <algorithm>
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	void RunComputeScheduler(const UltraEngine::Render::VkRenderer& renderer, shared_ptr<Object> extra)
+	{
+		auto hook = extra->As<ComputeSchedulerHook>();
+		if (hook == nullptr)
+		{
+			return;
+		}
+
+		auto world = hook->world.lock();
+		if (world != nullptr)
+		{
+			ComputeScheduler::Get()->Run(renderer.commandbuffer, world);
+		}
+	}
+
+	shared_ptr<ComputeScheduler> ComputeScheduler::Get()
+	{
+		static shared_ptr<ComputeScheduler> scheduler = make_shared<ComputeScheduler>();
+		return scheduler;
+	}
+
+	void ComputeScheduler::attach(shared_ptr<World> world)
+	{
+		for (int i = _worlds.size() - 1; i >= 0; i--)
+		{
+			auto attached = _worlds[i].lock();
+			if (attached == world)
+			{
+				return;
+			}
+			if (attached == nullptr)
+			{
+				_worlds.erase(_worlds.begin() + i);
+			}
+		}
+
+		if (ComputeShader::DescriptorPool == nullptr)
+		{
+			ComputeShader::DescriptorPool = make_shared<ComputeDescriptorPool>(world);
+		}
+		ComputeContext::Get()->Attach(world);
+
+		_worlds.push_back(world);
+		auto hook = make_shared<ComputeSchedulerHook>();
+		hook->world = world;
+		world->AddHook(HookID::HOOKID_TRANSFER, RunComputeScheduler, hook, true);
+	}
+
+	shared_ptr<ComputeCompletion> ComputeScheduler::Submit(shared_ptr<World> world, const string& name, ComputePriority priority, shared_ptr<ComputePassList> passes)
+	{
+		auto completion = ComputeCompletion::Create();
+		std::lock_guard<std::mutex> lock(_mutex);
+		attach(world);
+		_pending.push_back({ world, name, priority, passes, completion });
+		return completion;
+	}
+
+	shared_ptr<ComputeCompletion> ComputeScheduler::Submit(shared_ptr<World> world, const string& name, ComputePriority priority, shared_ptr<ComputeShader> shader, int tx, int ty, int tz, const void* pushData, size_t pushDataSize)
+	{
+		auto passes = ComputePassList::Create();
+		passes->Add(shader, tx, ty, tz, pushData, pushDataSize);
+		return Submit(world, name, priority, passes);
+	}
+
+	size_t ComputeScheduler::CountPending()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return _pending.size();
+	}
+
+	float ComputeScheduler::GetEstimate(const string& name)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return getEstimate(name);
+	}
+
+	float ComputeScheduler::getEstimate(const string& name)
+	{
+		auto it = _estimates.find(name);
+		return it != _estimates.end() ? it->second : _defaultEstimate;
+	}
+
+	void ComputeScheduler::initQueries(VkPhysicalDevice physicalDevice, VkDevice device)
+	{
+		// once, in the first frame
+		if (_queriesInitialized)
+		{
+			return;
+		}
+		_queriesInitialized = true;
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		_timestampsSupported = properties.limits.timestampComputeAndGraphics;
+		_timestampPeriod = properties.limits.timestampPeriod;
+
+		if (_timestampsSupported)
+		{
+			VkQueryPoolCreateInfo pool{};
+			pool.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			pool.queryCount = 2 * MAX_JOBS_PER_FRAME * QUERY_FRAMES;
+			pool.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &pool, nullptr, &_queryPool));
+		}
+	}
+
+	void ComputeScheduler::readTimestamps(VkDevice device, int frameSlot)
+	{
+		for (auto& job : _recorded[frameSlot])
+		{
+			uint64_t timestamps[2];
+			// no wait, a frame which has not completed yet only loses its samples
+			if (vkGetQueryPoolResults(device, _queryPool, job.query, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+			{
+				continue;
+			}
+
+			float milliseconds = float(timestamps[1] - timestamps[0]) * _timestampPeriod / 1e6f;
+			auto it = _estimates.find(job.name);
+			if (it == _estimates.end())
+			{
+				_estimates[job.name] = milliseconds;
+			}
+			else
+			{
+				// moving average, a single slow run does not throw the schedule off
+				it->second += (milliseconds - it->second) * 0.25f;
+			}
+		}
+		_recorded[frameSlot].clear();
+	}
+
+	void ComputeScheduler::Run(VkCommandBuffer commandBuffer, shared_ptr<World> world)
+	{
+		auto manager = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager;
+		VkDevice device = manager->device->device;
+		initQueries(manager->device->physicaldevice, device);
+
+		// the hooks of all worlds share the frame, it only advances with ComputeContext
+		uint64_t frame = ComputeContext::Get()->GetFrame();
+		bool newFrame = frame != _frame;
+		int frameSlot = frame % QUERY_FRAMES;
+		if (newFrame)
+		{
+			_frame = frame;
+			_frameJobs = 0;
+			_frameCost = 0.0f;
+		}
+		uint32_t firstQuery = frameSlot * 2 * MAX_JOBS_PER_FRAME + 2 * _frameJobs;
+
+		vector<Job> jobs;
+		vector<shared_ptr<ComputeCompletion>> dropped;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			// the slot was last used QUERY_FRAMES frames ago
+			if (newFrame && _timestampsSupported)
+			{
+				readTimestamps(device, frameSlot);
+			}
+
+			std::stable_sort(_pending.begin(), _pending.end(), [](const Job& a, const Job& b) { return a.priority < b.priority; });
+
+			for (int i = 0; i < _pending.size() && _frameJobs + jobs.size() < MAX_JOBS_PER_FRAME; i++)
+			{
+				auto target = _pending[i].world.lock();
+				if (target == nullptr)
+				{
+					// the world is gone, nothing will record the job
+					dropped.push_back(_pending[i].completion);
+					_pending.erase(_pending.begin() + i);
+					i--;
+					continue;
+				}
+				if (target != world)
+				{
+					continue;
+				}
+
+				float estimate = getEstimate(_pending[i].name);
+				if (_pending[i].priority != ComputePriority::CRITICAL && (_frameJobs > 0 || !jobs.empty()) && _frameCost + estimate > _budget)
+				{
+					// deferred, smaller jobs further down may still fit
+					continue;
+				}
+
+				_frameCost += estimate;
+				jobs.push_back(_pending[i]);
+				_pending.erase(_pending.begin() + i);
+				i--;
+			}
+			_lastFrameCost = _frameCost;
+		}
+
+		for (auto& completion : dropped)
+		{
+			completion->Complete();
+		}
+
+		if (jobs.empty())
+		{
+			return;
+		}
+		_frameJobs += jobs.size();
+
+		// only the queries of this world's jobs, the other worlds of the frame may use the rest of the slot
+		if (_timestampsSupported)
+		{
+			vkCmdResetQueryPool(commandBuffer, _queryPool, firstQuery, 2 * jobs.size());
+		}
+
+		for (int i = 0; i < jobs.size(); i++)
+		{
+			uint32_t query = firstQuery + 2 * i;
+			if (_timestampsSupported)
+			{
+				vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, _queryPool, query);
+			}
+
+			jobs[i].passes->Record(commandBuffer);
+			jobs[i].completion->Signal();
+
+			if (_timestampsSupported)
+			{
+				vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, _queryPool, query + 1);
+				std::lock_guard<std::mutex> lock(_mutex);
+				_recorded[frameSlot].push_back({ jobs[i].name, query });
+			}
+		}
+	}
+}
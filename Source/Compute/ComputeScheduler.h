@@ -0,0 +1,114 @@
+#pragma once
+#include "UltraEngine.h"
+#include "ComputeShader.h"
+#include "ComputePass.h"
+#include <map>
+#include <mutex>
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	void RunComputeScheduler(const UltraEngine::Render::VkRenderer& renderer, shared_ptr<Object> extra);
+
+	// Extra of the scheduler hook, one per world
+	class ComputeSchedulerHook : public Object
+	{
+	public:
+		weak_ptr<World> world;
+	};
+
+	enum class ComputePriority
+	{
+		// runs in the next frame regardless of the budget, e.g. work the frame depends on
+		CRITICAL = 0,
+		HIGH = 1,
+		NORMAL = 2,
+		LOW = 3,
+		// texture baking, GI updates and the like, only runs in what is left of the budget
+		BACKGROUND = 4
+	};
+
+	/// <summary>
+	/// Runs compute jobs within a GPU time budget per frame. Every frame the pending jobs are taken in priority order
+	/// (in submission order within a priority) as long as their estimated cost fits into the budget, the rest waits for
+	/// the next frame. The first job of a frame always runs, so a job larger than the budget is not postponed forever:
+	/// such jobs should be split (see ComputeShader::BeginTiledDispatch).
+	/// The cost of a job is learned from the timestamps of its earlier runs, jobs with the same name share their history.
+	/// Timestamps are read without waiting once their frame has completed, the scheduler never stalls the rendering thread.
+	/// Jobs are recorded by the world they were submitted for. The frames are those of ComputeContext, with several worlds
+	/// the budget and the job limit cover the jobs of all of them in a frame.
+	/// </summary>
+	class ComputeScheduler : public Object
+	{
+	public:
+		static constexpr int MAX_JOBS_PER_FRAME = 64;
+		// frames of timestamps kept, the oldest one has completed when it is read
+		static constexpr int QUERY_FRAMES = ComputeContext::MAX_FRAMES_IN_FLIGHT + 1;
+
+	private:
+		struct Job
+		{
+			weak_ptr<World> world;
+			string name;
+			ComputePriority priority;
+			shared_ptr<ComputePassList> passes;
+			shared_ptr<ComputeCompletion> completion;
+		};
+
+		struct RecordedJob
+		{
+			string name;
+			uint32_t query;
+		};
+
+		std::mutex _mutex;
+		vector<Job> _pending;
+		vector<weak_ptr<World>> _worlds;
+		std::map<string, float> _estimates;
+		vector<RecordedJob> _recorded[QUERY_FRAMES];
+
+		// rendering thread only
+		VkQueryPool _queryPool = VK_NULL_HANDLE;
+		bool _queriesInitialized = false;
+		bool _timestampsSupported = false;
+		float _timestampPeriod = 1.0f;
+		// the ComputeContext frame the jobs below were recorded in
+		uint64_t _frame = 0;
+		uint32_t _frameJobs = 0;
+		float _frameCost = 0.0f;
+
+		float _budget = 2.0f;
+		float _defaultEstimate = 0.5f;
+		float _lastFrameCost = 0.0f;
+
+		void attach(shared_ptr<World> world);
+		void initQueries(VkPhysicalDevice physicalDevice, VkDevice device);
+		void readTimestamps(VkDevice device, int frameSlot);
+		float getEstimate(const string& name);
+
+	public:
+		static shared_ptr<ComputeScheduler> Get();
+
+		// GPU milliseconds per frame the scheduled jobs may take
+		void SetBudget(float milliseconds) { _budget = milliseconds; }
+		float GetBudget() const { return _budget; }
+		// Cost assumed for a job which has not run before
+		void SetDefaultEstimate(float milliseconds) { _defaultEstimate = milliseconds; }
+
+		// Queues the passes, they are recorded in the transfer hook of the frame the scheduler picks.
+		// The handle completes once the GPU has executed them.
+		shared_ptr<ComputeCompletion> Submit(shared_ptr<World> world, const string& name, ComputePriority priority, shared_ptr<ComputePassList> passes);
+		// Queues a single dispatch, the push constants are copied
+		shared_ptr<ComputeCompletion> Submit(shared_ptr<World> world, const string& name, ComputePriority priority, shared_ptr<ComputeShader> shader, int tx, int ty, int tz, const void* pushData = nullptr, size_t pushDataSize = 0);
+
+		size_t CountPending();
+		// Learned GPU milliseconds of the named job, or the default estimate
+		float GetEstimate(const string& name);
+		// Estimated GPU milliseconds of the jobs recorded in the last frame
+		float GetLastFrameCost() const { return _lastFrameCost; }
+
+		// Records the jobs of the world which fit into what is left of the frame's budget
+		void Run(VkCommandBuffer commandBuffer, shared_ptr<World> world);
+	};
+}
@@ -1,5 +1,9 @@
 #include "UltraEngine.h"
 #include "ComputeShader.h"
+#include "ComputeTiledDispatch.h"
+#include "ComputeUploader.h"
+#include "ComputeMemoryStats.h"
+#include "ComputePipelineCompiler.h"
 #include "VulkanUtils.h"
 
 using namespace std;
@@ -12,12 +16,139 @@ namespace UltraEngine::Compute
 {
 	shared_ptr<ComputeDescriptorPool> ComputeShader::DescriptorPool = nullptr;
 
+	static void executeDispatch(VkCommandBuffer commandBuffer, const shared_ptr<ComputeDispatchInfo>& info)
+	{
+		bool recorded = info->ComputeShader->Dispatch(commandBuffer, info->Tx, info->Ty, info->Tz, info->pushConstants, info->pushConstantsSize, info->pushConstantsOffset);
+		info->callCount++;
+		if (info->completion != nullptr)
+		{
+			if (recorded)
+			{
+				info->completion->Signal();
+			}
+			else if (info->oneTime)
+			{
+				// dropped, nothing is left to wait for
+				info->completion->Complete();
+			}
+		}
+
+		// one-shot hooks are removed by the world after this call, so the record can be reused right away
+		if (info->oneTime)
+		{
+			ComputeDispatchPool::Get()->Release(info);
+		}
+	}
+
 	void BeginComputeShaderDispatch(const UltraEngine::Render::VkRenderer& renderer, shared_ptr<Object> extra)
 	{
 		auto info = extra->As<ComputeDispatchInfo>();
-		if (info != nullptr)
+		if (info == nullptr)
+		{
+			return;
+		}
+
+		auto shader = info->ComputeShader;
+		if (shader->GetCompilePolicy() == ComputeCompilePolicy::DEFER && shader->GetCompileState() != ComputeCompileState::READY
+			&& shader->GetCompileState() != ComputeCompileState::FAILED)
+		{
+			if (shader->GetCompileState() == ComputeCompileState::NONE)
+			{
+				shader->Precompile();
+			}
+
+			// repeating hooks try again in the next frame, one-shot ones wait at the frame boundary until the pipeline is ready
+			if (info->oneTime)
+			{
+				ComputeContext::Get()->Record([info](VkCommandBuffer commandBuffer)
+					{
+						if (info->ComputeShader->GetCompileState() == ComputeCompileState::COMPILING)
+						{
+							return true;
+						}
+						executeDispatch(commandBuffer, info);
+						return false;
+					});
+			}
+			return;
+		}
+
+		executeDispatch(renderer.commandbuffer, info);
+	}
+
+	int CountDispatchLayers(shared_ptr<Texture> texture, int miplevel)
+	{
+		if (texture->GetType() == TEXTURE_3D)
+		{
+			return std::max(1, texture->GetSize().z >> miplevel);
+		}
+		return texture->CountFaces();
+	}
+
+	shared_ptr<ComputeDispatchPool> ComputeDispatchPool::Get()
+	{
+		static shared_ptr<ComputeDispatchPool> pool = make_shared<ComputeDispatchPool>();
+		return pool;
+	}
+
+	shared_ptr<ComputeDispatchInfo> ComputeDispatchPool::Acquire()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (!_free.empty())
+			{
+				auto info = std::move(_free.back());
+				_free.pop_back();
+				return info;
+			}
+
+			// keep room for every record in existence, so Release never has to grow the free list. Grown geometrically,
+			// reserve alone would reallocate on every new record.
+			_count++;
+			if (_free.capacity() < _count)
+			{
+				_free.reserve(std::max<size_t>(64, _free.capacity() * 2));
+			}
+		}
+
+		return make_shared<ComputeDispatchInfo>();
+	}
+
+	void ComputeDispatchPool::Release(const shared_ptr<ComputeDispatchInfo>& info)
+	{
+		info->ComputeShader = nullptr;
+		info->pushConstants = nullptr;
+		info->pushConstantsSize = 0;
+		info->pushConstantsOffset = 0;
+		info->callCount = 0;
+		info->completion = nullptr;
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		_free.push_back(info);
+	}
+
+	// Range of the bytes which differ between the two blocks, begin == end if they are equal
+	static void findChangedRange(const uint8_t* a, const uint8_t* b, size_t size, size_t& begin, size_t& end)
+	{
+		const size_t chunk = 64;
+		begin = 0;
+		while (begin + chunk <= size && memcmp(a + begin, b + begin, chunk) == 0)
+		{
+			begin += chunk;
+		}
+		while (begin < size && a[begin] == b[begin])
+		{
+			begin++;
+		}
+
+		end = size;
+		while (end >= begin + chunk && memcmp(a + end - chunk, b + end - chunk, chunk) == 0)
 		{
-			info->ComputeShader->Dispatch(renderer.commandbuffer, info->Tx, info->Ty, info->Tz, info->pushConstants, info->pushConstantsSize, info->pushConstantsOffset);
+			end -= chunk;
+		}
+		while (end > begin && a[end - 1] == b[end - 1])
+		{
+			end--;
 		}
 	}
 
@@ -66,11 +197,20 @@ namespace UltraEngine::Compute
 				{
 					binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 				}
+
+				if (_bufferData[index]->mipCount > 0)
+				{
+					binding.descriptorCount = _bufferData[index]->mipCount;
+				}
 			}
 
-			if (_bufferData[index]->Data != nullptr)
+			if (_bufferData[index]->IsBuffer())
 			{
-				if (_bufferData[index]->IsDynamic)
+				if (_bufferData[index]->IsStorage)
+				{
+					binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				}
+				else if (_bufferData[index]->IsDynamic)
 				{
 					binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 				}
@@ -81,34 +221,59 @@ namespace UltraEngine::Compute
 			}
 
 			_layoutBindings.push_back(binding);
-			addtoPoolsize(binding.descriptorType);
+			addtoPoolsize(binding.descriptorType, binding.descriptorCount);
 		}
 
-		VkDescriptorSetLayoutCreateInfo descriptorLayout = initializers::descriptorSetLayoutCreateInfo(_layoutBindings);
-
-		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(device, &descriptorLayout, nullptr, &_computePipeLine->setLayout));
-
-		VkPipelineLayoutCreateInfo pPipelineLayoutCreateInfo = initializers::pipelineLayoutCreateInfo(&_computePipeLine->setLayout, 1);
-
+		// the second set of a ping-pong shader holds the same descriptors
+		if (_hasPingPong)
+		{
+			for (auto& poolSize : _poolSizes)
+			{
+				poolSize.descriptorCount *= 2;
+			}
+		}
 
-		if (_constantData != nullptr)
+		VkPushConstantRange* pushConstants = nullptr;
+		if (_constantData != nullptr || _tiled)
 		{
 			//this push constant range starts at the beginning
 			_constantDataRange.offset = 0;
 			//this push constant range takes up the size of a MeshPushConstants struct
-			_constantDataRange.size = _constantData->datasize;
+			_constantDataRange.size = _constantData != nullptr ? _constantData->datasize : 0;
+			if (_tiled)
+			{
+				// the tile offset follows the shader's own constants at the next 16 byte boundary
+				_tileOffsetField = GetTileOffsetField();
+				_constantDataRange.size = _tileOffsetField + 4 * sizeof(uint32_t);
+			}
 			//this push constant range is accessible only in the vertex shader
 			_constantDataRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
-			pPipelineLayoutCreateInfo.pPushConstantRanges = &_constantDataRange;
-			pPipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+			pushConstants = &_constantDataRange;
 		}
 
-		VK_CHECK_RESULT(vkCreatePipelineLayout(device, &pPipelineLayoutCreateInfo, nullptr, &_computePipeLine->pipelineLayout));
+		// shaders with the same bindings and push constants share the layouts
+		_layoutState = ComputePipelineCache::Get()->GetLayout(device, _layoutBindings, _bindless, pushConstants);
+		_computePipeLine->setLayout = _layoutState->setLayout;
+		_computePipeLine->pipelineLayout = _layoutState->pipelineLayout;
+
+		{
+			// shaders may be prepared on the compiler thread and the rendering thread at once
+			static std::mutex poolMutex;
+			std::lock_guard<std::mutex> lock(poolMutex);
+			if (ComputeShader::DescriptorPool == nullptr)
+			{
+				ComputeShader::DescriptorPool = make_shared<ComputeDescriptorPool>(nullptr);
+			}
+			if (!ComputeShader::DescriptorPool->Initialized)
+			{
+				ComputeShader::DescriptorPool->Init(device);
+			}
+		}
 
-		if (!ComputeShader::DescriptorPool->Initialized)
+		if (_bufferData.empty())
 		{
-			ComputeShader::DescriptorPool->Init(device);
+			return;
 		}
 
 		VkDescriptorPoolCreateInfo descriptorPoolInfo{};
@@ -118,6 +283,7 @@ namespace UltraEngine::Compute
 		descriptorPoolInfo.maxSets = 3;
 
 		VK_CHECK_RESULT(vkCreateDescriptorPool(device, &descriptorPoolInfo, nullptr, &_computePipeLine->descriptorPool));
+		ComputeMemoryStats::Get()->Track((uint64_t)_computePipeLine->descriptorPool, ComputeResourceType::DESCRIPTOR_POOL);
 
 		VkDescriptorSetAllocateInfo allocInfo{};
 		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -126,14 +292,40 @@ namespace UltraEngine::Compute
 		allocInfo.descriptorSetCount = 1;
 
 		VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &_computePipeLine->descriptorSet));
+
+		if (_hasPingPong)
+		{
+			VK_CHECK_RESULT(vkAllocateDescriptorSets(device, &allocInfo, &_computePipeLine->pingPongSet));
+		}
 	}
 
 	void ComputeShader::initLayoutData(VkDevice device)
 	{
 		for (int index = 0; index < _bufferData.size(); index++)
 		{
-			if (_bufferData[index]->Texture != nullptr)
+			if (_bufferData[index]->mipCount > 0)
 			{
+				_bufferData[index]->createMipViews(device);
+
+				auto descrWrite = initializers::writeDescriptorSet(
+					_computePipeLine->descriptorSet,
+					VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+					index + bufferoffset,
+					_bufferData[index]->mipImageInfos.data(),
+					_bufferData[index]->mipImageInfos.size()
+				);
+
+				_writeDescriptorSets.push_back(descrWrite);
+			}
+			else if (_bufferData[index]->Texture != nullptr)
+			{
+				if (_bufferData[index]->PingPongTexture != nullptr)
+				{
+					_bufferData[index]->createImageView(device, _bufferData[index]->PingPongTexture);
+					_bufferData[index]->pingPongView = _bufferData[index]->mipmapImage;
+					_bufferData[index]->pingPongInfo = initializers::descriptorImageInfo(VK_NULL_HANDLE, _bufferData[index]->pingPongView, VK_IMAGE_LAYOUT_GENERAL);
+				}
+
 				auto imageInfo = new VkDescriptorImageInfo;
 				imageInfo->imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 				_bufferData[index]->createImageView(device, _bufferData[index]->Texture);
@@ -165,19 +357,57 @@ namespace UltraEngine::Compute
 				}
 			}
 
-			if (_bufferData[index]->Data != nullptr)
+			if (_bufferData[index]->IsBuffer())
 			{
+				if (_bufferData[index]->StorageBuffer != nullptr)
+				{
+					auto descrWrite = initializers::writeDescriptorSet(
+						_computePipeLine->descriptorSet,
+						VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+						index + bufferoffset,
+						&_bufferData[index]->StorageBuffer->GetBuffer().descriptor
+					);
+
+					_writeDescriptorSets.push_back(descrWrite);
+					continue;
+				}
+
 				auto gpudevice = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device;
 
-				VK_CHECK_RESULT(createBuffer(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+				const void* initialData = _bufferData[index]->Data;
+				if (_bufferData[index]->Block != nullptr)
+				{
+					_bufferData[index]->Block->Acquire();
+					initialData = _bufferData[index]->Block->GetFront();
+				}
+
+				// device local, the data goes through the uploader which records it before the dispatch
+				auto uploader = ComputeUploader::Get();
+				VK_CHECK_RESULT(createBuffer((_bufferData[index]->IsStorage ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT : VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					uploader->GetTargetMemory(),
 					&_bufferData[index]->InternalBuffer,
-					_bufferData[index]->datasize, _bufferData[index]->Data));
+					_bufferData[index]->datasize, nullptr));
+
+				if (initialData != nullptr)
+				{
+					uploader->Write(_bufferData[index]->InternalBuffer, initialData, _bufferData[index]->datasize);
+				}
+				else
+				{
+					vector<uint8_t> zeros(_bufferData[index]->datasize, 0);
+					uploader->Write(_bufferData[index]->InternalBuffer, zeros.data(), zeros.size());
+				}
+				_bytesUploaded += _bufferData[index]->datasize;
+				if (_bufferData[index]->Block != nullptr)
+				{
+					auto front = static_cast<const uint8_t*>(initialData);
+					_bufferData[index]->uploaded.assign(front, front + _bufferData[index]->datasize);
+				}
 
 				VkWriteDescriptorSet writeDescriptorSet{};
 				writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 				writeDescriptorSet.dstSet = _computePipeLine->descriptorSet;
-				writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				writeDescriptorSet.descriptorType = _layoutBindings[index].descriptorType;
 				writeDescriptorSet.dstBinding = index + bufferoffset;
 				writeDescriptorSet.pBufferInfo = &_bufferData[index]->InternalBuffer.descriptor;
 				writeDescriptorSet.descriptorCount = 1;
@@ -186,29 +416,278 @@ namespace UltraEngine::Compute
 		}
 
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(_writeDescriptorSets.size()), _writeDescriptorSets.data(), 0, NULL);
+		_descriptorWrites += _writeDescriptorSets.size();
+
+		if (_hasPingPong)
+		{
+			updatePingPongSet(device);
+		}
+	}
+
+	void ComputeShader::updatePingPongSet(VkDevice device)
+	{
+		// same descriptors as the first set, with the textures of the ping-pong bindings exchanged
+		vector<VkWriteDescriptorSet> writes = _writeDescriptorSets;
+		for (int index = 0; index < writes.size(); index++)
+		{
+			writes[index].dstSet = _computePipeLine->pingPongSet;
+			if (index < _bufferData.size() && _bufferData[index]->PingPongTexture != nullptr)
+			{
+				writes[index].pImageInfo = &_bufferData[index]->pingPongInfo;
+			}
+		}
+
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, NULL);
+		_descriptorWrites += writes.size();
+	}
+
+	void ComputeShader::prepare()
+	{
+		std::call_once(_prepared, [this]()
+			{
+				std::lock_guard<std::mutex> lock(_reloadMutex);
+				VkDevice device = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device->device;
+				ComputeMemoryScope memoryScope(_name);
+				_compileState = ComputeCompileState::COMPILING;
+
+				_computePipeLine = make_shared<ComputePipeline>();
+
+				initLayout(device);
+
+				// only the first shader with this code, specialization and layout compiles the pipeline
+				_pipelineState = ComputePipelineCache::Get()->GetPipeline(getCodeKey(), _layoutState, [this, device](VkPipelineLayout layout, VkPipeline* pipeline)
+					{
+						if (_code.empty())
+						{
+							return createPipeline(device, _shaderModule->GetHandle(), layout, pipeline);
+						}
+
+						VkShaderModule module = tools::loadShaderModule(device, _code.data(), _code.size() * sizeof(uint32_t));
+						if (module == VK_NULL_HANDLE)
+						{
+							return VK_ERROR_INITIALIZATION_FAILED;
+						}
+						VkResult result = createPipeline(device, module, layout, pipeline);
+						vkDestroyShaderModule(device, module, nullptr);
+						return result;
+					});
+
+				if (_pipelineState != nullptr)
+				{
+					_computePipeLine->pipeline = _pipelineState->pipeline;
+					_compileState = ComputeCompileState::READY;
+				}
+				else
+				{
+					_compileState = ComputeCompileState::FAILED;
+				}
+			});
 	}
 
 	void ComputeShader::init(VkDevice device)
 	{
 		if (!_initialized)
 		{
-			_computePipeLine = make_shared<ComputePipeline>();
-			
-			initLayout(device);
+			// waits if the compiler thread is building the pipeline right now
+			prepare();
+			// the buffers and image views are created on the rendering thread, they are cheap compared to the pipeline
+			initLayoutData(device);
+			_initialized = true;
+
+			// from the next frame on the data is updated ahead of the frame's dispatches, all shaders in one batch
+			weak_ptr<ComputeShader> self = Self()->As<ComputeShader>();
+			ComputeContext::Get()->Prepare([self](VkDevice device)
+				{
+					auto shader = self.lock();
+					if (shader == nullptr)
+					{
+						return false;
+					}
+					shader->updateData(device);
+					shader->_updatedFrame = ComputeContext::Get()->GetFrame();
+					return true;
+				});
+		}
+	}
+
+	shared_ptr<ComputeCompletion> ComputeShader::Precompile()
+	{
+		auto completion = ComputeCompletion::Create();
+		auto state = _compileState.load();
+		if (state == ComputeCompileState::READY || state == ComputeCompileState::FAILED)
+		{
+			completion->Complete();
+			return completion;
+		}
 
-			VkComputePipelineCreateInfo info = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
-			info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-			info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-			info.stage.module = _shaderModule->GetHandle();
-			info.stage.pName = "main";
-			info.layout = _computePipeLine->pipelineLayout;
+		auto expected = ComputeCompileState::NONE;
+		_compileState.compare_exchange_strong(expected, ComputeCompileState::COMPILING);
 
-			VK_CHECK_RESULT(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &info, nullptr, &_computePipeLine->pipeline));
+		// shaders dropped before their turn, e.g. by level streaming, are not compiled
+		weak_ptr<ComputeShader> shader = Self()->As<ComputeShader>();
+		ComputePipelineCompiler::Get()->Submit([shader, completion]()
+			{
+				auto locked = shader.lock();
+				if (locked != nullptr)
+				{
+					locked->prepare();
+				}
+				completion->Complete();
+			});
+		return completion;
+	}
 
-			initLayoutData(device);
+	shared_ptr<ComputeCompletion> ComputeShader::Precompile(const vector<shared_ptr<ComputeShader>>& shaders)
+	{
+		auto completion = ComputeCompletion::Create();
+		vector<weak_ptr<ComputeShader>> batch;
+		for (auto& shader : shaders)
+		{
+			auto expected = ComputeCompileState::NONE;
+			shader->_compileState.compare_exchange_strong(expected, ComputeCompileState::COMPILING);
+			batch.push_back(shader);
+		}
 
-			_initialized = true;
+		ComputePipelineCompiler::Get()->Submit([batch, completion]()
+			{
+				for (auto& shader : batch)
+				{
+					auto locked = shader.lock();
+					if (locked != nullptr)
+					{
+						locked->prepare();
+					}
+				}
+				completion->Complete();
+			});
+		return completion;
+	}
+
+	VkResult ComputeShader::createPipeline(VkDevice device, VkShaderModule module, VkPipelineLayout layout, VkPipeline* pipeline)
+	{
+		if (module == VK_NULL_HANDLE)
+		{
+			return VK_ERROR_INITIALIZATION_FAILED;
+		}
+
+		VkSpecializationInfo specialization = initializers::specializationInfo(_specializationEntries, _specializationData.size() * sizeof(uint32_t), _specializationData.data());
+
+		VkComputePipelineCreateInfo info = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+		info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		info.stage.module = module;
+		info.stage.pName = "main";
+		info.stage.pSpecializationInfo = _specializationEntries.empty() ? nullptr : &specialization;
+		info.layout = layout;
+
+		return vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &info, nullptr, pipeline);
+	}
+
+	string ComputeShader::getCodeKey()
+	{
+		string key;
+		if (!_code.empty())
+		{
+			key = ComputePipelineCache::CodeKey(_code.data(), _code.size() * sizeof(uint32_t));
+		}
+		else if (!_moduleKey.empty())
+		{
+			key = _moduleKey;
+		}
+		else
+		{
+			// the content of a file which could not be read is unknown, only the module itself can share its pipeline
+			key = "module:" + std::to_string(uint64_t(_shaderModule->GetHandle()));
 		}
+
+		for (int i = 0; i < _specializationEntries.size(); i++)
+		{
+			key += ":" + std::to_string(_specializationEntries[i].constantID) + "=" + std::to_string(_specializationData[i]);
+		}
+		return key;
+	}
+
+	void ComputeShader::SetSpecializationConstant(uint32_t constantID, uint32_t value)
+	{
+		if (_compileState != ComputeCompileState::NONE)
+		{
+			Print("Error: Specialization constants must be set before the first dispatch or Precompile.");
+			return;
+		}
+
+		for (int i = 0; i < _specializationEntries.size(); i++)
+		{
+			if (_specializationEntries[i].constantID == constantID)
+			{
+				_specializationData[i] = value;
+				return;
+			}
+		}
+		_specializationEntries.push_back(initializers::specializationMapEntry(constantID, _specializationData.size() * sizeof(uint32_t), sizeof(uint32_t)));
+		_specializationData.push_back(value);
+	}
+
+	void ComputeShader::SetSpecializationConstant(uint32_t constantID, float value)
+	{
+		uint32_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		SetSpecializationConstant(constantID, bits);
+	}
+
+	void ComputeShader::swapPipeline(shared_ptr<ComputePipelineState> state)
+	{
+		// the old pipeline is retired by its state once no shader uses it
+		_pipelineState = state;
+		_computePipeLine->pipeline = state->pipeline;
+		_compileState = ComputeCompileState::READY;
+	}
+
+	bool ComputeShader::Reload(const vector<uint32_t>& spirv)
+	{
+		if (spirv.empty())
+		{
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(_reloadMutex);
+
+		// not compiled yet, the new code is used when it is
+		if (_layoutState == nullptr)
+		{
+			_code = spirv;
+			return true;
+		}
+
+		VkDevice device = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device->device;
+
+		// instances reloading the same code share the new pipeline as well
+		vector<uint32_t> previous = _code;
+		_code = spirv;
+		auto state = ComputePipelineCache::Get()->GetPipeline(getCodeKey(), _layoutState, [this, device, &spirv](VkPipelineLayout layout, VkPipeline* pipeline)
+			{
+				VkShaderModule module = tools::loadShaderModule(device, spirv.data(), spirv.size() * sizeof(uint32_t));
+				if (module == VK_NULL_HANDLE)
+				{
+					return VK_ERROR_INITIALIZATION_FAILED;
+				}
+				VkResult result = createPipeline(device, module, layout, pipeline);
+				vkDestroyShaderModule(device, module, nullptr);
+				return result;
+			});
+
+		if (state == nullptr)
+		{
+			Print("Error: Failed to reload compute shader " + _name);
+			_code = previous;
+			return false;
+		}
+
+		auto shader = Self()->As<ComputeShader>();
+		ComputeContext::Get()->Enqueue([shader, state]()
+			{
+				shader->swapPipeline(state);
+			});
+		return true;
 	}
 
 	void ComputeShader::updateData(VkDevice device)
@@ -217,25 +696,43 @@ namespace UltraEngine::Compute
 
 		for (int index = 0; index < _bufferData.size(); index++)
 		{
-			if (_bufferData[index]->Update)
+			// parameter blocks are flagged by publishing, the bytes in which the latest complete version differs are uploaded
+			if (_bufferData[index]->Block != nullptr && _bufferData[index]->Block->Acquire())
 			{
-				if (_bufferData[index]->Data != nullptr)
+				auto front = static_cast<const uint8_t*>(_bufferData[index]->Block->GetFront());
+				auto& uploaded = _bufferData[index]->uploaded;
+				size_t begin, end;
+				findChangedRange(front, uploaded.data(), uploaded.size(), begin, end);
+				if (begin < end)
 				{
-					_bufferData[index]->InternalBuffer.map();
+					ComputeUploader::Get()->Write(_bufferData[index]->InternalBuffer, front + begin, end - begin, begin);
+					_bytesUploaded += end - begin;
+					memcpy(uploaded.data() + begin, front + begin, end - begin);
+				}
+			}
 
-					_bufferData[index]->InternalBuffer.copyTo(_bufferData[index]->Data, _bufferData[index]->datasize);
+			size_t offset, size;
+			if (_bufferData[index]->Data != nullptr && _bufferData[index]->takeDirty(offset, size))
+			{
+				ComputeUploader::Get()->Write(_bufferData[index]->InternalBuffer, static_cast<const uint8_t*>(_bufferData[index]->Data) + offset, size, offset);
+				_bytesUploaded += size;
+			}
 
-					_bufferData[index]->InternalBuffer.unmap();
+			if (_bufferData[index]->Update)
+			{
 
+				if (_bufferData[index]->mipCount > 0)
+				{
+					_bufferData[index]->createMipViews(device);
+					_writeDescriptorSets[index].pImageInfo = _bufferData[index]->mipImageInfos.data();
 					updateDescriptorSet = true;
 				}
-
-				if (_bufferData[index]->Texture != nullptr)
+				else if (_bufferData[index]->Texture != nullptr)
 				{
 					auto imageInfo = new VkDescriptorImageInfo;
 					imageInfo->imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-
+					ComputeContext::Get()->Retire(_bufferData[index]->mipmapImage);
 					_bufferData[index]->createImageView(device, _bufferData[index]->Texture);
 					imageInfo->imageView = _bufferData[index]->mipmapImage;
 					imageInfo->sampler = _bufferData[index]->Texture->GetSampler();
@@ -250,17 +747,23 @@ namespace UltraEngine::Compute
 		if (updateDescriptorSet)
 		{
 			vkUpdateDescriptorSets(device, static_cast<uint32_t>(_writeDescriptorSets.size()), _writeDescriptorSets.data(), 0, NULL);
+			_descriptorWrites += _writeDescriptorSets.size();
+
+			if (_hasPingPong)
+			{
+				updatePingPongSet(device);
+			}
 		}
 	}
 
-	void ComputeShader::addtoPoolsize(VkDescriptorType descriptionType)
+	void ComputeShader::addtoPoolsize(VkDescriptorType descriptionType, uint32_t count)
 	{
 		bool existed = false;
 		for (int i = 0; i < _poolSizes.size(); i++)
 		{
 			if (_poolSizes[i].type == descriptionType)
 			{
-				_poolSizes[i].descriptorCount++;
+				_poolSizes[i].descriptorCount += count;
 				existed = true;
 			}
 		}
@@ -269,43 +772,90 @@ namespace UltraEngine::Compute
 		{
 			VkDescriptorPoolSize size;
 			size.type = descriptionType;
-			size.descriptorCount = 1;
+			size.descriptorCount = count;
 			_poolSizes.push_back(size);
 		}
 	}
 
+	static string nextShaderName()
+	{
+		static std::atomic<int> count = 0;
+		return "ComputeShader" + std::to_string(++count);
+	}
+
 	ComputeShader::ComputeShader(shared_ptr<ShaderModule> module)
 	{
 		_shaderModule = module;
 		_timestampQuery = make_shared<TimeStampQuery>();
+		_name = nextShaderName();
+	}
+
+	ComputeShader::ComputeShader(const uint32_t* code, size_t codeSize)
+	{
+		_code.assign(code, code + codeSize / sizeof(uint32_t));
+		_timestampQuery = make_shared<TimeStampQuery>();
+		_name = nextShaderName();
+	}
+
+	ComputeShader::~ComputeShader()
+	{
+		// the binding data retires its own views and buffers and the shared states their pipeline and layouts,
+		// descriptor sets go with their pool
+		if (_computePipeLine != nullptr)
+		{
+			ComputeContext::Get()->Retire(_computePipeLine->descriptorPool);
+		}
 	}
 
 	shared_ptr<ComputeShader> ComputeShader::Create(const WString& path)
 	{
-		auto mod = LoadShaderModule(path);
+		string key;
+		auto mod = ComputePipelineCache::Get()->LoadModule(path, &key);
 		auto shader = make_shared<ComputeShader>(mod);
+		shader->_moduleKey = key;
+		return shader;
+	}
+
+	shared_ptr<ComputeShader> ComputeShader::CreateFromMemory(const uint32_t* code, size_t codeSize)
+	{
+		auto shader = make_shared<ComputeShader>(code, codeSize);
 		return shader;
 	}
 
-	void ComputeShader::BeginDispatch(shared_ptr<World> world, int tx, int ty, int tz, bool oneTime, ComputeHook hook, void* pushData, size_t pushDataSize, int pushDataOffset)
+	shared_ptr<ComputeCompletion> ComputeShader::BeginDispatch(shared_ptr<World> world, int tx, int ty, int tz, bool oneTime, ComputeHook hook, void* pushData, size_t pushDataSize, int pushDataOffset)
 	{
-		auto info = make_shared<ComputeDispatchInfo>();
+		auto completion = ComputeCompletion::Create();
+		auto info = ComputeDispatchPool::Get()->Acquire();
 		info->ComputeShader = this->Self()->As<ComputeShader>();
 		info->Tx = tx;
 		info->Ty = ty;
 		info->Tz = tz;
-		info->World = world;
-		info->Self = info;
 		info->pushConstants = pushData;
 		info->pushConstantsSize = pushDataSize;
 		info->pushConstantsOffset = pushDataOffset;
 		info->hook = hook;
+		info->oneTime = oneTime;
+		info->completion = completion;
+
+		if (oneTime && pushData != nullptr && pushDataSize <= sizeof(info->pushConstantStorage))
+		{
+			memcpy(info->pushConstantStorage, pushData, pushDataSize);
+			info->pushConstants = info->pushConstantStorage;
+		}
 
 
 		if (ComputeShader::DescriptorPool == nullptr)
 		{
 			ComputeShader::DescriptorPool = make_shared<ComputeDescriptorPool>(world);
 		}
+
+		ComputeContext::Get()->Attach(world);
+		// the pipeline starts compiling now rather than in the frame which records the dispatch
+		if (_compileState == ComputeCompileState::NONE)
+		{
+			Precompile();
+		}
+
 		switch (hook)
 		{
 		case ComputeHook::RENDER:
@@ -315,14 +865,51 @@ namespace UltraEngine::Compute
 			world->AddHook(HookID::HOOKID_TRANSFER, BeginComputeShaderDispatch, info, !oneTime);
 			break;
 		}
+		return completion;
 	}
 
-	void ComputeShader::Dispatch(VkCommandBuffer cBuffer, int tx, int ty, int tz, void* pushData, size_t pushDataSize, int pushDataOffset)
+	bool ComputeShader::Dispatch(VkCommandBuffer cBuffer, int tx, int ty, int tz, void* pushData, size_t pushDataSize, int pushDataOffset)
+	{
+		ComputeTile tile;
+		tile.tx = tx;
+		tile.ty = ty;
+		tile.tz = tz;
+		return record(cBuffer, &tile, 1, VK_NULL_HANDLE, 0, ComputeImageSync::DISCARD, pushData, pushDataSize, pushDataOffset);
+	}
+
+	bool ComputeShader::DispatchIndirect(VkCommandBuffer cBuffer, VkBuffer buffer, VkDeviceSize offset, void* pushData, size_t pushDataSize, int pushDataOffset)
+	{
+		return record(cBuffer, nullptr, 0, buffer, offset, ComputeImageSync::DISCARD, pushData, pushDataSize, pushDataOffset);
+	}
+
+	bool ComputeShader::DispatchTiles(VkCommandBuffer cBuffer, const ComputeTile* tiles, size_t tileCount, ComputeImageSync imageSync, void* pushData, size_t pushDataSize, int pushDataOffset)
+	{
+		return record(cBuffer, tiles, tileCount, VK_NULL_HANDLE, 0, imageSync, pushData, pushDataSize, pushDataOffset);
+	}
+
+	bool ComputeShader::record(VkCommandBuffer cBuffer, const ComputeTile* tiles, size_t tileCount, VkBuffer indirectBuffer, VkDeviceSize indirectOffset, ComputeImageSync imageSync, void* pushData, size_t pushDataSize, int pushDataOffset)
 	{
 		auto manager = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager;
 
 		VkDevice device = manager->device->device;
 
+		if (!IsReady() && _compilePolicy == ComputeCompilePolicy::SKIP)
+		{
+			if (_compileState == ComputeCompileState::NONE)
+			{
+				Precompile();
+			}
+			return false;
+		}
+		ComputeMemoryScope memoryScope(_name);
+
+		//initializes the layout and Writedescriptors, waits for the pipeline if it is still compiling
+		init(device);
+		if (_computePipeLine->pipeline == VK_NULL_HANDLE)
+		{
+			return false;
+		}
+
 		_timestampQuery->Init(manager->device->physicaldevice, manager->device->device);
 
 		_timestampQuery->Reset(cBuffer);
@@ -333,43 +920,119 @@ namespace UltraEngine::Compute
 
 		bool barrierActive = false;
 		bool isValid = true;
-		auto path = _shaderModule->GetPath();
 
-		for (int index = 0; index < _bufferData.size(); index++)
+		for (int index = 0; index < _bufferData.size() && imageSync != ComputeImageSync::EXTERNAL; index++)
 		{
-			if (_bufferData[index]->Texture != nullptr && _bufferData[index]->IsWrite)
+			if (_bufferData[index]->Texture != nullptr && _bufferData[index]->IsWrite && _bufferData[index]->mipCount == 0 && _bufferData[index]->PingPongTexture == nullptr)
 			{
-				u_int layercount = 1;
-				if (_bufferData[index]->Texture->GetType() == TEXTURE_CUBE)
+				u_int baseLayer, layerCount;
+				_bufferData[index]->getLayerRange(baseLayer, layerCount);
+
+				// later tiles of a tiled dispatch keep what the earlier ones wrote
+				if (imageSync == ComputeImageSync::PRESERVE)
 				{
-					layercount = 6;
+					tools::insertImageMemoryBarrier(cBuffer, _bufferData[index]->Texture->GetImage(),
+						VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT,
+						VK_IMAGE_LAYOUT_GENERAL,
+						VK_IMAGE_LAYOUT_GENERAL,
+						VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+						VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						{ VK_IMAGE_ASPECT_COLOR_BIT, (u_int)_bufferData[index]->mipLevel, 1, baseLayer, layerCount });
+					continue;
 				}
 
 				tools::setImageLayout(cBuffer, _bufferData[index]->Texture->GetImage(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
-					{ VK_IMAGE_ASPECT_COLOR_BIT, (u_int)_bufferData[index]->Texture->CountMipmaps() - 1,VK_REMAINING_MIP_LEVELS, 0, layercount }, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+					{ VK_IMAGE_ASPECT_COLOR_BIT, (u_int)_bufferData[index]->mipLevel, 1, baseLayer, layerCount }, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 
 				tools::insertImageMemoryBarrier(cBuffer, _bufferData[index]->Texture->GetImage(), 0, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT,
 					VK_IMAGE_LAYOUT_UNDEFINED,
 					VK_IMAGE_LAYOUT_GENERAL,
 					VK_PIPELINE_STAGE_TRANSFER_BIT,
 					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-					{ VK_IMAGE_ASPECT_COLOR_BIT, (u_int)_bufferData[index]->Texture->CountMipmaps() - 1,VK_REMAINING_MIP_LEVELS, 0, layercount });
-				break;
+					{ VK_IMAGE_ASPECT_COLOR_BIT, (u_int)_bufferData[index]->mipLevel, 1, baseLayer, layerCount });
 			}
 
 		}
 
-		//initializes the layout and Writedescriptors
-		init(device);
+		// mip arrays may read levels written before (e.g. a pyramid built from its base level), so they are synchronized
+		// in place instead of being transitioned from undefined
+		for (int index = 0; index < _bufferData.size(); index++)
+		{
+			if (_bufferData[index]->mipCount > 0)
+			{
+				tools::insertImageMemoryBarrier(cBuffer, _bufferData[index]->Texture->GetImage(),
+					VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT,
+					VK_IMAGE_LAYOUT_GENERAL,
+					VK_IMAGE_LAYOUT_GENERAL,
+					VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					{ VK_IMAGE_ASPECT_COLOR_BIT, (u_int)_bufferData[index]->mipLevel, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS });
+			}
+		}
+
+		// the images of a ping-pong pair carry their content from one step to the next, they are only transitioned from
+		// undefined before the first step. Both textures of the pair are covered as each one is the Texture of one binding.
+		for (int index = 0; index < _bufferData.size(); index++)
+		{
+			if (_bufferData[index]->PingPongTexture != nullptr)
+			{
+				bool initialized = _bufferData[index]->pingPongInitialized;
+				tools::insertImageMemoryBarrier(cBuffer, _bufferData[index]->Texture->GetImage(),
+					initialized ? VK_ACCESS_SHADER_WRITE_BIT : 0, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT,
+					initialized ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED,
+					VK_IMAGE_LAYOUT_GENERAL,
+					VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					{ VK_IMAGE_ASPECT_COLOR_BIT, (u_int)_bufferData[index]->mipLevel, 1, 0, VK_REMAINING_ARRAY_LAYERS });
+				_bufferData[index]->pingPongInitialized = true;
+			}
+		}
 
-		//updates the uniform buffer data when needed
-		updateData(device);
+		// the frame's batch already carries the data, except in the frame the shader was initialized
+		uint64_t frame = ComputeContext::Get()->GetFrame();
+		if (_updatedFrame != frame)
+		{
+			updateData(device);
+			_updatedFrame = frame;
+			if (ComputeUploader::Get()->HasPending())
+			{
+				ComputeUploader::Get()->Flush(cBuffer);
+			}
+		}
 
 		vkCmdBindPipeline(cBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _computePipeLine->pipeline);
 
 		// Bind descriptor set.
-		vkCmdBindDescriptorSets(cBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _computePipeLine->pipelineLayout, 0, 1,
-			&_computePipeLine->descriptorSet, 0, nullptr);
+		uint32_t firstSet = 0;
+		if (_bindless)
+		{
+			VkDescriptorSet heapSet = ComputeBindlessHeap::Get()->Flush(device, cBuffer);
+
+			// the resources a bindless dispatch touches are unknown, so earlier shader writes are made visible globally
+			VkMemoryBarrier memoryBarrier = initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			vkCmdPipelineBarrier(cBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			vkCmdBindDescriptorSets(cBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _computePipeLine->pipelineLayout, 0, 1,
+				&heapSet, 0, nullptr);
+			firstSet = 1;
+		}
+
+		VkDescriptorSet descriptorSet = _computePipeLine->descriptorSet;
+		if (_hasPingPong)
+		{
+			// flips for every step, the bindings of the pair trade places in the next dispatch
+			if (_parity.fetch_xor(1) == 1)
+			{
+				descriptorSet = _computePipeLine->pingPongSet;
+			}
+		}
+		if (descriptorSet != VK_NULL_HANDLE)
+		{
+			vkCmdBindDescriptorSets(cBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, _computePipeLine->pipelineLayout, firstSet, 1,
+				&descriptorSet, 0, nullptr);
+		}
 
 		// Bind the compute pipeline.
 		if (pushData != nullptr)
@@ -379,9 +1042,46 @@ namespace UltraEngine::Compute
 
 		_timestampQuery->write(cBuffer, 0);
 		// Dispatch compute job.
-		vkCmdDispatch(cBuffer, tx, ty, tz);
+		if (indirectBuffer != VK_NULL_HANDLE)
+		{
+			if (_tiled)
+			{
+				uint32_t offset[4] = { 0, 0, 0, 0 };
+				vkCmdPushConstants(cBuffer, _computePipeLine->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, _tileOffsetField, sizeof(offset), offset);
+			}
+			vkCmdDispatchIndirect(cBuffer, indirectBuffer, indirectOffset);
+		}
+		else if (_tiled)
+		{
+			for (size_t n = 0; n < tileCount; n++)
+			{
+				dispatchTile(cBuffer, tiles[n]);
+			}
+		}
+		else
+		{
+			for (size_t n = 0; n < tileCount; n++)
+			{
+				vkCmdDispatch(cBuffer, tiles[n].tx, tiles[n].ty, tiles[n].tz);
+			}
+		}
 
 		_timestampQuery->write(cBuffer, 1);
+		_dispatchCount++;
+
+		for (int index = 0; index < _bufferData.size(); index++)
+		{
+			if (_bufferData[index]->mipCount > 0)
+			{
+				tools::insertImageMemoryBarrier(cBuffer, _bufferData[index]->Texture->GetImage(),
+					VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+					VK_IMAGE_LAYOUT_GENERAL,
+					VK_IMAGE_LAYOUT_GENERAL,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+					{ VK_IMAGE_ASPECT_COLOR_BIT, (u_int)_bufferData[index]->mipLevel, VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS });
+			}
+		}
 
 		if (barrierActive)
 		{
@@ -402,13 +1102,32 @@ namespace UltraEngine::Compute
 					1, &barriers[i]);
 			}
 		}
+		return true;
+	}
+
+	shared_ptr<ComputeCompletion> ComputeShader::BeginLayeredDispatch(shared_ptr<World> world, shared_ptr<Texture> texture, int miplevel, int localSizeX, int localSizeY, bool oneTime, ComputeHook hook, void* pushData, size_t pushDataSize, int pushDataOffset)
+	{
+		int width = std::max(1, texture->GetSize().x >> miplevel);
+		int height = std::max(1, texture->GetSize().y >> miplevel);
+
+		return BeginDispatch(world, (width + localSizeX - 1) / localSizeX, (height + localSizeY - 1) / localSizeY, CountDispatchLayers(texture, miplevel),
+			oneTime, hook, pushData, pushDataSize, pushDataOffset);
 	}
 
-	int ComputeShader::AddTargetImage(shared_ptr<Texture> texture, int miplevel)
+	int ComputeShader::AddTargetImage(shared_ptr<Texture> texture, int miplevel, ComputeImageView view)
 	{
+		// a 2D view of a volume slice needs the image created 2D array compatible and the image2DViewOf3D feature,
+		// neither of which the engine's textures have
+		if (view == ComputeImageView::LAYER && texture->GetType() == TEXTURE_3D)
+		{
+			Print("Error: ComputeShader can not bind a slice of a 3D texture as image2D, bind the volume as image3D and pass the slice in the push constants");
+			return -1;
+		}
+
 		auto data = make_shared<ComputeBufferData>();
 		data->Texture = texture;
 		data->mipLevel = miplevel;
+		data->viewType = view;
 		data->IsWrite = true;
 		data->IsDynamic = false;
 
@@ -416,10 +1135,72 @@ namespace UltraEngine::Compute
 		return _bufferData.size() - 1;
 	}
 
-	int ComputeShader::AddSampler(shared_ptr<Texture> texture)
+	int ComputeShader::AddTargetImageLayer(shared_ptr<Texture> texture, int layer, int miplevel)
+	{
+		int index = AddTargetImage(texture, miplevel, ComputeImageView::LAYER);
+		if (index < 0)
+		{
+			return -1;
+		}
+		_bufferData[index]->layer = layer;
+		return index;
+	}
+
+	int ComputeShader::AddPingPongImages(shared_ptr<Texture> first, shared_ptr<Texture> second)
+	{
+		int index = AddTargetImage(first);
+		_bufferData[index]->PingPongTexture = second;
+
+		int other = AddTargetImage(second);
+		_bufferData[other]->PingPongTexture = first;
+
+		_hasPingPong = true;
+		return index;
+	}
+
+	int ComputeShader::AddPingPongImages(int width, int height, TextureFormat format)
 	{
+		auto first = CreateTexture(TEXTURE_2D, width, height, format, {}, 1, TEXTURE_STORAGE, TEXTUREFILTER_LINEAR);
+		auto second = CreateTexture(TEXTURE_2D, width, height, format, {}, 1, TEXTURE_STORAGE, TEXTUREFILTER_LINEAR);
+		return AddPingPongImages(first, second);
+	}
+
+	shared_ptr<Texture> ComputeShader::GetPingPongTexture(int layoutIndex)
+	{
+		auto& data = _bufferData[layoutIndex];
+		if (data->PingPongTexture != nullptr && _parity == 1)
+		{
+			return data->PingPongTexture;
+		}
+		return data->Texture;
+	}
+
+	int ComputeShader::AddTargetImageMips(shared_ptr<Texture> texture, int firstMip, int count, bool arrayView)
+	{
+		if (firstMip < 0 || firstMip >= int(texture->CountMipmaps()) || count <= 0)
+		{
+			Print("Error: ComputeShader::AddTargetImageMips needs count > 0 and firstMip below the " + std::to_string(texture->CountMipmaps())
+				+ " mip levels of the texture, got firstMip " + std::to_string(firstMip) + " and count " + std::to_string(count));
+			return -1;
+		}
+
 		auto data = make_shared<ComputeBufferData>();
 		data->Texture = texture;
+		data->mipLevel = firstMip;
+		data->mipCount = count;
+		data->mipArrayView = arrayView;
+		data->IsWrite = true;
+		data->IsDynamic = false;
+
+		_bufferData.push_back(data);
+		return _bufferData.size() - 1;
+	}
+
+	int ComputeShader::AddSampler(shared_ptr<Texture> texture, ComputeImageView view)
+	{
+		auto data = make_shared<ComputeBufferData>();
+		data->Texture = texture;
+		data->viewType = view;
 		data->IsWrite = false;
 		data->IsDynamic = false;
 
@@ -439,6 +1220,42 @@ namespace UltraEngine::Compute
 		return _bufferData.size() - 1;
 	}
 
+	int ComputeShader::AddStorageBuffer(void* data, size_t dataSize)
+	{
+		auto ssbodata = make_shared<ComputeBufferData>();
+		ssbodata->Data = data;
+		ssbodata->datasize = dataSize;
+		ssbodata->IsWrite = true;
+		ssbodata->IsStorage = true;
+
+		_bufferData.push_back(ssbodata);
+		return _bufferData.size() - 1;
+	}
+
+	int ComputeShader::AddStorageBuffer(shared_ptr<ComputeStorageBuffer> buffer)
+	{
+		auto ssbodata = make_shared<ComputeBufferData>();
+		ssbodata->StorageBuffer = buffer;
+		ssbodata->datasize = buffer->GetSize();
+		ssbodata->IsWrite = true;
+		ssbodata->IsStorage = true;
+
+		_bufferData.push_back(ssbodata);
+		return _bufferData.size() - 1;
+	}
+
+	int ComputeShader::AddParameterBlock(shared_ptr<ParameterBlockBase> block, bool dynamic)
+	{
+		auto ubodata = make_shared<ComputeBufferData>();
+		ubodata->Block = block;
+		ubodata->datasize = block->GetSize();
+		ubodata->IsWrite = false;
+		ubodata->IsDynamic = dynamic;
+
+		_bufferData.push_back(ubodata);
+		return _bufferData.size() - 1;
+	}
+
 	void ComputeShader::SetupPushConstant(size_t dataSize)
 	{
 		auto ubodata = make_shared<ComputeBufferData>();
@@ -448,39 +1265,179 @@ namespace UltraEngine::Compute
 		_constantData = ubodata;
 	}
 
+	void ComputeShader::EnableTiling()
+	{
+		_tiled = true;
+	}
+
+	uint32_t ComputeShader::GetTileOffsetField() const
+	{
+		uint32_t size = _constantData != nullptr ? _constantData->datasize : 0;
+		return (size + 15) & ~15u;
+	}
+
+	shared_ptr<ComputeTiledDispatch> ComputeShader::BeginTiledDispatch(shared_ptr<World> world, int tx, int ty, int tz, int tileX, int tileY, int tileZ, int tilesPerFrame, const void* pushData, size_t pushDataSize)
+	{
+		if (!_tiled)
+		{
+			Print("Error: ComputeShader::BeginTiledDispatch needs EnableTiling before the first dispatch");
+			return nullptr;
+		}
+
+		if (ComputeShader::DescriptorPool == nullptr)
+		{
+			ComputeShader::DescriptorPool = make_shared<ComputeDescriptorPool>(world);
+		}
+		ComputeContext::Get()->Attach(world);
+		if (_compileState == ComputeCompileState::NONE)
+		{
+			Precompile();
+		}
+
+		auto dispatch = make_shared<ComputeTiledDispatch>(Self()->As<ComputeShader>(), tx, ty, tz, tileX, tileY, tileZ, tilesPerFrame, pushData, pushDataSize);
+		ComputeContext::Get()->Record([dispatch](VkCommandBuffer commandBuffer)
+			{
+				return dispatch->Record(commandBuffer);
+			});
+		return dispatch;
+	}
+
+	void ComputeShader::dispatchTile(VkCommandBuffer cBuffer, const ComputeTile& tile)
+	{
+		if (_maxGroupCount[0] == 0)
+		{
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device->physicaldevice, &properties);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				_maxGroupCount[axis] = properties.limits.maxComputeWorkGroupCount[axis];
+			}
+		}
+
+		// tiles larger than the device limit are split further, every part gets its own offset
+		for (uint32_t z = 0; z < uint32_t(tile.tz); z += _maxGroupCount[2])
+		{
+			for (uint32_t y = 0; y < uint32_t(tile.ty); y += _maxGroupCount[1])
+			{
+				for (uint32_t x = 0; x < uint32_t(tile.tx); x += _maxGroupCount[0])
+				{
+					uint32_t offset[4] = { tile.x + x, tile.y + y, tile.z + z, 0 };
+					vkCmdPushConstants(cBuffer, _computePipeLine->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, _tileOffsetField, sizeof(offset), offset);
+					vkCmdDispatch(cBuffer, std::min(_maxGroupCount[0], tile.tx - x), std::min(_maxGroupCount[1], tile.ty - y), std::min(_maxGroupCount[2], tile.tz - z));
+				}
+			}
+		}
+	}
+
+	void ComputeShader::SetBindless(bool enable)
+	{
+		// the update-after-bind layout of the heap is invalid unless the device enabled descriptor indexing
+		if (enable && !ComputeBindlessHeap::IsEnabled())
+		{
+			Print("Error: ComputeShader::SetBindless needs ComputeBindlessHeap::Enable(true)");
+			_bindless = false;
+			return;
+		}
+		_bindless = enable;
+	}
+
 	void ComputeShader::Update(int layoutIndex)
 	{
+		_bufferData[layoutIndex]->markDirty(0, _bufferData[layoutIndex]->datasize);
 		_bufferData[layoutIndex]->Update = true;
 	}
 
+	void ComputeShader::UpdateRange(int layoutIndex, size_t offset, size_t size)
+	{
+		if (offset + size > _bufferData[layoutIndex]->datasize)
+		{
+			Print("Error: ComputeShader::UpdateRange exceeds the size of the binding");
+			return;
+		}
+		_bufferData[layoutIndex]->markDirty(offset, size);
+	}
+
 	void ComputeShader::UpdateTexture(int layoutIndex, shared_ptr<Texture> texture)
 	{
 		_bufferData[layoutIndex]->Texture = texture;
 		_bufferData[layoutIndex]->Update = true;
 	}
 
-	void ComputeBufferData::createImageView(VkDevice device, shared_ptr<UltraEngine::Texture> texture)
+	void ComputeBufferData::markDirty(size_t offset, size_t size)
 	{
-		int faces = 1;
-		VkImageViewCreateInfo viewInfo = {};
-		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-		viewInfo.image = texture->GetImage();
-		switch (texture->GetType())
+		std::lock_guard<std::mutex> lock(dirtyMutex);
+		if (dirtyBegin == dirtyEnd)
+		{
+			dirtyBegin = offset;
+			dirtyEnd = offset + size;
+			return;
+		}
+		dirtyBegin = std::min(dirtyBegin, offset);
+		dirtyEnd = std::max(dirtyEnd, offset + size);
+	}
+
+	bool ComputeBufferData::takeDirty(size_t& offset, size_t& size)
+	{
+		std::lock_guard<std::mutex> lock(dirtyMutex);
+		if (dirtyBegin == dirtyEnd)
+		{
+			return false;
+		}
+		offset = dirtyBegin;
+		size = dirtyEnd - dirtyBegin;
+		dirtyBegin = 0;
+		dirtyEnd = 0;
+		return true;
+	}
+
+	VkImageViewType ComputeBufferData::getImageViewType() const
+	{
+		int faces = Texture->CountFaces();
+		switch (viewType)
+		{
+		case ComputeImageView::LAYER:
+			return VK_IMAGE_VIEW_TYPE_2D;
+		case ComputeImageView::CUBE:
+			return faces > 6 ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE;
+		case ComputeImageView::ARRAY:
+			// the slices of a volume are addressed by its z coordinate already
+			return Texture->GetType() == TEXTURE_3D ? VK_IMAGE_VIEW_TYPE_3D : VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		}
+
+		switch (Texture->GetType())
 		{
-			//case TEXTURE_1D:
-			//	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_1D;
-			//	break;
-		case TEXTURE_2D:
-			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-			break;
 		case TEXTURE_3D:
-			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_3D;
-			break;
+			return VK_IMAGE_VIEW_TYPE_3D;
 		case TEXTURE_CUBE:
-			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
-			faces = texture->CountFaces();
-			break;
+			return faces > 6 ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE;
 		}
+		return faces > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+	}
+
+	void ComputeBufferData::getLayerRange(uint32_t& baseLayer, uint32_t& layerCount) const
+	{
+		baseLayer = 0;
+		layerCount = 1;
+		if (Texture->GetType() == TEXTURE_3D)
+		{
+			// a volume has a single layer, its slices are addressed by the z coordinate of an image3D
+			return;
+		}
+
+		if (viewType == ComputeImageView::LAYER)
+		{
+			baseLayer = layer;
+			return;
+		}
+		layerCount = Texture->CountFaces();
+	}
+
+	void ComputeBufferData::createImageView(VkDevice device, shared_ptr<UltraEngine::Texture> texture)
+	{
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = texture->GetImage();
+		viewInfo.viewType = getImageViewType();
 
 		viewInfo.format = VkFormat(texture->GetFormat());
 		switch (viewInfo.format)
@@ -496,15 +1453,91 @@ namespace UltraEngine::Compute
 			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 			break;
 		}
+
+		uint32_t baseLayer, layerCount;
+		getLayerRange(baseLayer, layerCount);
+
 		viewInfo.subresourceRange.baseMipLevel = mipLevel;
-		viewInfo.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
-		viewInfo.subresourceRange.baseArrayLayer = 0;
-		viewInfo.subresourceRange.layerCount = faces;
+		// storage image views may only address a single mip level
+		viewInfo.subresourceRange.levelCount = IsWrite ? 1 : VK_REMAINING_MIP_LEVELS;
+		viewInfo.subresourceRange.baseArrayLayer = baseLayer;
+		viewInfo.subresourceRange.layerCount = layerCount;
 		viewInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
 		viewInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
 		viewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
 		viewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
 
 		VK_CHECK_RESULT(vkCreateImageView(device, &viewInfo, NULL, &mipmapImage));
+		ComputeMemoryStats::Get()->Track((uint64_t)mipmapImage, ComputeResourceType::IMAGE_VIEW);
+	}
+
+	ComputeBufferData::~ComputeBufferData()
+	{
+		auto context = ComputeContext::Get();
+		context->Retire(mipmapImage);
+		context->Retire(pingPongView);
+		for (auto view : mipViews)
+		{
+			context->Retire(view);
+		}
+		context->Retire(InternalBuffer);
+	}
+
+	void ComputeBufferData::createMipViews(VkDevice device)
+	{
+		int levels = Texture->CountMipmaps();
+		int layers = Texture->CountFaces();
+
+		VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D;
+		if (Texture->GetType() == TEXTURE_3D)
+		{
+			viewType = VK_IMAGE_VIEW_TYPE_3D;
+			layers = 1;
+		}
+		else if (mipArrayView || layers > 1)
+		{
+			viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		}
+
+		// descriptor sets of the last frames may still reference the old views
+		for (auto view : mipViews)
+		{
+			ComputeContext::Get()->Retire(view);
+		}
+		mipViews.clear();
+		mipImageInfos.clear();
+
+		// a texture set by UpdateTexture may have fewer levels than the one the range was checked against
+		int firstLevel = mipLevel;
+		if (firstLevel >= levels)
+		{
+			Print("Error: The texture bound with AddTargetImageMips has " + std::to_string(levels) + " mip levels, binding the last one instead of level " + std::to_string(mipLevel));
+			firstLevel = levels - 1;
+		}
+		int viewCount = std::min(mipCount, levels - firstLevel);
+
+		for (int level = firstLevel; level < firstLevel + viewCount; level++)
+		{
+			VkImageViewCreateInfo viewInfo = initializers::imageViewCreateInfo();
+			viewInfo.image = Texture->GetImage();
+			viewInfo.viewType = viewType;
+			viewInfo.format = VkFormat(Texture->GetFormat());
+			viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			viewInfo.subresourceRange.baseMipLevel = level;
+			viewInfo.subresourceRange.levelCount = 1;
+			viewInfo.subresourceRange.baseArrayLayer = 0;
+			viewInfo.subresourceRange.layerCount = layers;
+
+			VkImageView view;
+			VK_CHECK_RESULT(vkCreateImageView(device, &viewInfo, NULL, &view));
+			ComputeMemoryStats::Get()->Track((uint64_t)view, ComputeResourceType::IMAGE_VIEW);
+			mipViews.push_back(view);
+		}
+
+		for (int element = 0; element < mipCount; element++)
+		{
+			VkImageView view = mipViews[std::min(element, viewCount - 1)];
+			mipImageInfos.push_back(initializers::descriptorImageInfo(VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL));
+		}
 	}
-}
\ No newline at end of file
+}
@@ -1,5 +1,13 @@
 #pragma once
 #include "VulkanUtils.h"
+#include "ParameterBlock.h"
+#include "ComputeContext.h"
+#include "ComputeCompletion.h"
+#include "ComputeBindlessHeap.h"
+#include "ComputeStorageBuffer.h"
+#include "ComputePipelineCache.h"
+#include <atomic>
+#include <mutex>
 using namespace UltraEngine::Compute::Utils;
 
 
@@ -8,6 +16,7 @@ namespace UltraEngine::Compute
 	class ComputeShader;
 	class ComputePipelineBuilder;
 	class ComputeDispatchInfo;
+	class ComputeTiledDispatch;
 
 	void BeginComputeShaderDispatch(const UltraEngine::Render::VkRenderer& renderer, shared_ptr<Object> extra);
 
@@ -17,12 +26,81 @@ namespace UltraEngine::Compute
 		TRANSFER = HOOKID_TRANSFER
 	};
 
+	/// <summary>
+	/// How an image binding addresses the layers of its texture.
+	/// </summary>
+	enum class ComputeImageView
+	{
+		// image2D, image3D or imageCube, texture arrays are bound as image2DArray
+		DEFAULT,
+		// all layers or cube faces as image2DArray, gl_GlobalInvocationID.z of a layered dispatch selects the layer
+		ARRAY,
+		// the six faces (or a multiple of six for cube arrays) as imageCube / imageCubeArray
+		CUBE,
+		// a single layer or cube face as image2D. Not available for 3D textures, bind the volume as image3D instead.
+		LAYER
+	};
+
+	/// <summary>
+	/// How a dispatch synchronizes the storage images it writes. Mip arrays and ping-pong pairs always synchronize themselves.
+	/// </summary>
+	enum class ComputeImageSync
+	{
+		// transitioned from undefined, the previous content is discarded
+		DISCARD,
+		// kept in the general layout, e.g. for the later tiles of a tiled dispatch which keep what the earlier ones wrote
+		PRESERVE,
+		// no barriers at all, the caller records them (see ComputeGraph)
+		EXTERNAL
+	};
+
+	enum class ComputeCompileState
+	{
+		// nothing requested the pipeline yet
+		NONE,
+		// queued or being built on the ComputePipelineCompiler thread
+		COMPILING,
+		READY,
+		FAILED
+	};
+
+	/// <summary>
+	/// What happens to dispatches of a shader whose pipeline is still compiling.
+	/// </summary>
+	enum class ComputeCompilePolicy
+	{
+		// the dispatch waits for the pipeline, on the rendering thread
+		BLOCK,
+		// one-shot dispatches of BeginDispatch run at the beginning of the first frame after the pipeline is ready, repeating
+		// ones and tiled dispatches skip the frames until then. Dispatches recorded into a given command buffer wait.
+		DEFER,
+		// dispatches are dropped until the pipeline is ready, their completions complete without any work
+		SKIP
+	};
+
+	// Number of layers a layered dispatch covers at the mip level: cube faces, array layers or the depth of a volume
+	int CountDispatchLayers(shared_ptr<Texture> texture, int miplevel = 0);
+
+	// A box of workgroups: the first group and the number of groups on each axis
+	struct ComputeTile
+	{
+		int x = 0;
+		int y = 0;
+		int z = 0;
+		int tx = 1;
+		int ty = 1;
+		int tz = 1;
+	};
+
 	struct ComputePipeline
 	{
+		// the pipeline and layouts belong to the shared states of ComputePipelineCache, the descriptor sets to the shader
 		VkPipeline pipeline = VK_NULL_HANDLE;
 		VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
 		VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
 		VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		// Second descriptor set with the ping-pong bindings swapped, only allocated when the shader has any
+		VkDescriptorSet pingPongSet = VK_NULL_HANDLE;
 		VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
 	};
 
@@ -38,17 +116,38 @@ namespace UltraEngine::Compute
 	class ComputeDispatchInfo : public Object
 	{
 	public:
-		shared_ptr<ComputeDispatchInfo> Self;
 		shared_ptr<ComputeShader> ComputeShader;
 		int Tx;
 		int Ty;
 		int Tz;
-		shared_ptr<World> World;
 		void* pushConstants = nullptr;
 		size_t pushConstantsSize = 0;
 		int pushConstantsOffset = 0;
+		// one-shot dispatches keep a copy of their push constants, the caller's data may be gone when the hook fires
+		uint8_t pushConstantStorage[128];
 		ComputeHook hook = ComputeHook::RENDER;
+		bool oneTime = true;
 		int callCount = 0;
+		// signaled by the first execution
+		shared_ptr<ComputeCompletion> completion;
+	};
+
+	/// <summary>
+	/// Recycles the dispatch records passed to the world hooks.
+	/// Records are acquired on the game thread and handed back by the rendering thread once a one-shot hook has fired,
+	/// in steady state neither side allocates.
+	/// </summary>
+	class ComputeDispatchPool : public Object
+	{
+	private:
+		std::mutex _mutex;
+		vector<shared_ptr<ComputeDispatchInfo>> _free;
+		size_t _count = 0;
+
+	public:
+		static shared_ptr<ComputeDispatchPool> Get();
+		shared_ptr<ComputeDispatchInfo> Acquire();
+		void Release(const shared_ptr<ComputeDispatchInfo>& info);
 	};
 
 	class ComputeBufferData : Object
@@ -57,15 +156,50 @@ namespace UltraEngine::Compute
 		void* Data = nullptr;
 		size_t datasize;
 		shared_ptr<Texture> Texture = nullptr;
+		shared_ptr<ParameterBlockBase> Block = nullptr;
+		// buffer owned by the application, used instead of InternalBuffer
+		shared_ptr<ComputeStorageBuffer> StorageBuffer = nullptr;
 		int mipLevel = 0;
+		ComputeImageView viewType = ComputeImageView::DEFAULT;
+		int layer = 0;
 		ComputeBuffer InternalBuffer;
 		bool IsDynamic = false;
 		bool IsWrite = false;
 		bool Update = false;
 		bool IsPushConstant = false;
+		bool IsStorage = false;
 		VkImageView mipmapImage = VK_NULL_HANDLE;
 
+		// Bytes of Data changed since the last upload, set on the game thread by Update and UpdateRange
+		std::mutex dirtyMutex;
+		size_t dirtyBegin = 0;
+		size_t dirtyEnd = 0;
+		// Parameter blocks: the data uploaded last, new versions only upload the bytes which differ from it
+		vector<uint8_t> uploaded;
+
+		// Ping-pong bindings: Texture is bound in even steps, PingPongTexture in odd ones
+		shared_ptr<UltraEngine::Texture> PingPongTexture = nullptr;
+		VkImageView pingPongView = VK_NULL_HANDLE;
+		VkDescriptorImageInfo pingPongInfo = {};
+		bool pingPongInitialized = false;
+
+		// Mip array bindings: one single level view per array element starting at mipLevel, elements past the last level repeat it
+		int mipCount = 0;
+		bool mipArrayView = false;
+		vector<VkImageView> mipViews;
+		vector<VkDescriptorImageInfo> mipImageInfos;
+
+		// Retires the views and the internal buffer
+		~ComputeBufferData();
 		void createImageView(VkDevice device, shared_ptr<UltraEngine::Texture> texture);
+		VkImageViewType getImageViewType() const;
+		// Layers of the image the binding accesses, used for the view and the layout transitions
+		void getLayerRange(uint32_t& baseLayer, uint32_t& layerCount) const;
+		void createMipViews(VkDevice device);
+		void markDirty(size_t offset, size_t size);
+		// Returns false if nothing changed since the last call
+		bool takeDirty(size_t& offset, size_t& size);
+		bool IsBuffer() const { return Data != nullptr || Block != nullptr || IsStorage; }
 	};
 
 	class ComputeShader : public Object
@@ -83,30 +217,155 @@ namespace UltraEngine::Compute
 
 		VkPipelineCache _pipelineCache;
 		shared_ptr<ComputePipeline> _computePipeLine;
+		shared_ptr<ComputeLayoutState> _layoutState;
+		shared_ptr<ComputePipelineState> _pipelineState;
+		vector<VkSpecializationMapEntry> _specializationEntries;
+		vector<uint32_t> _specializationData;
+
+		std::mutex _reloadMutex;
+		// SPIR-V used instead of the shader module, set by CreateFromMemory or a reload before the first dispatch
+		vector<uint32_t> _code;
+		// ComputePipelineCache::CodeKey of the file _shaderModule was loaded from
+		string _moduleKey;
+
+		// Selects the descriptor set of the next dispatch, flipped by every dispatch of a shader with ping-pong bindings
+		std::atomic<int> _parity = 0;
+		bool _hasPingPong = false;
+		bool _bindless = false;
+
+		// Tiled shaders receive the first workgroup of every dispatch in the push constants
+		bool _tiled = false;
+		uint32_t _tileOffsetField = 0;
+		uint32_t _maxGroupCount[3] = { 0, 0, 0 };
+
+		// Owner of the shader's buffers, views and pools in ComputeMemoryStats
+		string _name;
+
+		// totals since creation, read by ComputeTelemetry
+		std::atomic<uint64_t> _dispatchCount = 0;
+		std::atomic<uint64_t> _descriptorWrites = 0;
+		std::atomic<uint64_t> _bytesUploaded = 0;
+
+		std::atomic<ComputeCompileState> _compileState = ComputeCompileState::NONE;
+		ComputeCompilePolicy _compilePolicy = ComputeCompilePolicy::DEFER;
+		std::once_flag _prepared;
 
 		bool _executed = false;
-		bool _initialized = false;
+		std::atomic<bool> _initialized = false;
+		// rendering thread only, the frame whose batch carries the latest data
+		uint64_t _updatedFrame = 0;
 		void initLayout(VkDevice device);
 		void initLayoutData(VkDevice device);
+		// Builds the layouts, descriptor sets and pipeline once, on whichever thread gets there first
+		void prepare();
 		void init(VkDevice device);
 		void updateData(VkDevice device);
-		void addtoPoolsize(VkDescriptorType descriptionType);
+		void addtoPoolsize(VkDescriptorType descriptionType, uint32_t count = 1);
+		void updatePingPongSet(VkDevice device);
+		bool record(VkCommandBuffer cBuffer, const ComputeTile* tiles, size_t tileCount, VkBuffer indirectBuffer, VkDeviceSize indirectOffset, ComputeImageSync imageSync, void* pushData, size_t pushDataSize, int pushDataOffset);
+		void dispatchTile(VkCommandBuffer cBuffer, const ComputeTile& tile);
+		VkResult createPipeline(VkDevice device, VkShaderModule module, VkPipelineLayout layout, VkPipeline* pipeline);
+		// Identifies the code and the specialization constants in the pipeline cache
+		string getCodeKey();
+		void swapPipeline(shared_ptr<ComputePipelineState> state);
 
 
 	public:
 		static shared_ptr<ComputeDescriptorPool> DescriptorPool;
 		ComputeShader(shared_ptr<ShaderModule> module);
+		ComputeShader(const uint32_t* code, size_t codeSize);
+		// The Vulkan objects are destroyed once the frames which may still use them have completed
+		~ComputeShader();
 		static shared_ptr<ComputeShader> Create(const WString& path);
+		// Creates the shader from SPIR-V in memory, e.g. the arrays in Generated/EmbeddedShaders.h. codeSize is given in bytes.
+		static shared_ptr<ComputeShader> CreateFromMemory(const uint32_t* code, size_t codeSize);
 		int bufferoffset = 0;
-		void BeginDispatch(shared_ptr<World> world, int tx, int ty, int tz, bool oneTime = true, ComputeHook hook = ComputeHook::RENDER, void* pushData = nullptr, size_t pushDataSize = 0, int pushDataOffset = 0);
-		void Dispatch(VkCommandBuffer cBuffer, int tx, int ty, int tz, void* pushData, size_t pushDataSize, int pushDataOffset);
-		int AddTargetImage(shared_ptr<Texture> texture, int miplevel = 0);
-		int AddSampler(shared_ptr<Texture> texture);
+		// The returned handle completes once the GPU has executed the dispatch, for repeating dispatches the first execution
+		shared_ptr<ComputeCompletion> BeginDispatch(shared_ptr<World> world, int tx, int ty, int tz, bool oneTime = true, ComputeHook hook = ComputeHook::RENDER, void* pushData = nullptr, size_t pushDataSize = 0, int pushDataOffset = 0);
+		// The Dispatch functions return false if nothing was recorded, because the pipeline failed or is still compiling
+		// under ComputeCompilePolicy::SKIP.
+		bool Dispatch(VkCommandBuffer cBuffer, int tx, int ty, int tz, void* pushData, size_t pushDataSize, int pushDataOffset);
+		// Takes the group counts from a VkDispatchIndirectCommand at the offset of the buffer, which needs VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT.
+		// Writes to the buffer by earlier dispatches need a barrier with VK_ACCESS_INDIRECT_COMMAND_READ_BIT.
+		bool DispatchIndirect(VkCommandBuffer cBuffer, VkBuffer buffer, VkDeviceSize offset, void* pushData, size_t pushDataSize, int pushDataOffset);
+		// Dispatches each tile separately, tiles of shaders without tiling enabled are dispatched as they are.
+		// imageSync selects the barriers recorded for the storage images the dispatch writes.
+		bool DispatchTiles(VkCommandBuffer cBuffer, const ComputeTile* tiles, size_t tileCount, ComputeImageSync imageSync, void* pushData, size_t pushDataSize, int pushDataOffset);
+		// Dispatches enough groups to cover the mip level of the texture, one group layer per face, array layer or volume slice.
+		// localSizeX and localSizeY are the workgroup size of the shader, its local_size_z has to be 1.
+		shared_ptr<ComputeCompletion> BeginLayeredDispatch(shared_ptr<World> world, shared_ptr<Texture> texture, int miplevel, int localSizeX, int localSizeY, bool oneTime = true, ComputeHook hook = ComputeHook::RENDER, void* pushData = nullptr, size_t pushDataSize = 0, int pushDataOffset = 0);
+		int AddTargetImage(shared_ptr<Texture> texture, int miplevel = 0, ComputeImageView view = ComputeImageView::DEFAULT);
+		// Binds a single layer or cube face as image2D. Returns -1 for a 3D texture.
+		int AddTargetImageLayer(shared_ptr<Texture> texture, int layer, int miplevel = 0);
+		int AddSampler(shared_ptr<Texture> texture, ComputeImageView view = ComputeImageView::DEFAULT);
+		// Binds count mip levels starting at firstMip as an array of storage images, e.g. "uniform image2D mips[count]".
+		// Array elements past the last mip of the texture repeat the last one, so the shader can use a fixed array size.
+		// With arrayView the levels are bound as image2DArray, which cube and array textures always use.
+		// Returns -1 if firstMip is not a level of the texture or count is not positive.
+		int AddTargetImageMips(shared_ptr<Texture> texture, int firstMip, int count, bool arrayView = false);
+		// Binds two storage images which swap places after every dispatch, e.g. the source and destination of a simulation step.
+		// first is bound at the returned index and second at the index after it, the next dispatch binds them the other way round.
+		// Both descriptor sets are built up front, so a swap costs nothing but binding the other set.
+		int AddPingPongImages(shared_ptr<Texture> first, shared_ptr<Texture> second);
+		// Creates both textures of the pair
+		int AddPingPongImages(int width, int height, TextureFormat format);
+		// Texture bound at the index in the next dispatch. For the source binding of a step this is the result of the last step.
+		shared_ptr<Texture> GetPingPongTexture(int layoutIndex);
+		int GetPingPongParity() const { return _parity; }
 		int AddUniformBuffer(void* data, size_t dataSize, bool dynamic);
+		// Without data the storage buffer is zero initialized
+		int AddStorageBuffer(void* data, size_t dataSize);
+		int AddStorageBuffer(shared_ptr<ComputeStorageBuffer> buffer);
+		int AddParameterBlock(shared_ptr<ParameterBlockBase> block, bool dynamic = false);
 		void SetupPushConstant(size_t dataSize);
+		// Sets a specialization constant (layout (constant_id = id) const uint/int/bool/float), call before the first dispatch.
+		// Shaders with the same code and constants share their pipeline.
+		void SetSpecializationConstant(uint32_t constantID, uint32_t value);
+		void SetSpecializationConstant(uint32_t constantID, float value);
+		// Binds the global ComputeBindlessHeap as set 0, the shader's own bindings move to set 1. Call before the first dispatch.
+		// Fails with an error unless ComputeBindlessHeap::Enable(true) was called.
+		void SetBindless(bool enable);
+
+		// Reserves a uvec4 in the push constants which receives the first workgroup of each dispatch, at GetTileOffsetField()
+		// (the shader's own constants rounded up to 16 bytes). The shader adds it to its group ID:
+		//   layout (push_constant) uniform Constants { ...; uvec4 tileOffset; } params;
+		//   uvec3 id = (gl_WorkGroupID + params.tileOffset.xyz) * gl_WorkGroupSize + gl_LocalInvocationID;
+		// Dispatches of tiled shaders are split automatically where they exceed maxComputeWorkGroupCount.
+		// Call before the first dispatch, after SetupPushConstant.
+		void EnableTiling();
+		uint32_t GetTileOffsetField() const;
+		// Splits the grid into tiles of tileX * tileY * tileZ workgroups, e.g. to stay below the GPU watchdog or to keep the frame
+		// responsive. With tilesPerFrame 0 all tiles are recorded in the next frame, otherwise that many per frame.
+		// The returned object tracks the progress. The push constants are copied.
+		shared_ptr<ComputeTiledDispatch> BeginTiledDispatch(shared_ptr<World> world, int tx, int ty, int tz, int tileX, int tileY, int tileZ, int tilesPerFrame = 0, const void* pushData = nullptr, size_t pushDataSize = 0);
+		// Uploads the data of a uniform or storage buffer binding again at the next dispatch
 		void Update(int layoutIndex = 0);
+		// Only uploads the bytes in the range, e.g. the one entry of a large table which changed. Ranges of several calls
+		// before the next dispatch are merged.
+		void UpdateRange(int layoutIndex, size_t offset, size_t size);
 		void UpdateTexture(int layoutIndex, shared_ptr<Texture> texture);
 		shared_ptr<TimeStampQuery> GetQueryTimer() { return _timestampQuery; };
+		// Totals since the shader was created
+		uint64_t CountDispatches() const { return _dispatchCount; }
+		uint64_t CountDescriptorWrites() const { return _descriptorWrites; }
+		uint64_t GetBytesUploaded() const { return _bytesUploaded; }
+		// Names the shader in the memory statistics, set before the first dispatch. Defaults to "ComputeShader" and a number.
+		void SetName(const string& name) { _name = name; }
+		const string& GetName() const { return _name; }
+
+		// Builds the pipeline on the ComputePipelineCompiler thread, with the bindings added so far: call once all are added.
+		// The first BeginDispatch starts it as well. The returned handle completes once the pipeline is ready or failed.
+		shared_ptr<ComputeCompletion> Precompile();
+		// Warms up a batch of shaders, e.g. behind a loading screen, the handle completes once all are done
+		static shared_ptr<ComputeCompletion> Precompile(const vector<shared_ptr<ComputeShader>>& shaders);
+		ComputeCompileState GetCompileState() const { return _compileState; }
+		bool IsReady() const { return _compileState == ComputeCompileState::READY; }
+		void SetCompilePolicy(ComputeCompilePolicy policy) { _compilePolicy = policy; }
+		ComputeCompilePolicy GetCompilePolicy() const { return _compilePolicy; }
+
+		// Builds a new pipeline from the SPIR-V code on the calling thread, it replaces the current one at the next frame boundary.
+		// The descriptor layout has to stay the same. Returns false and keeps the current pipeline if the code is invalid.
+		bool Reload(const vector<uint32_t>& spirv);
 	};
 
 }
@@ -0,0 +1,179 @@
+#include "UltraEngine.h"
+#include "ComputeShaderWatcher.h"
+#include <cstdio>
+#include <fstream>
+#include <functional>
+
+#if defined(_WIN32)
+#define popen _popen
+#define pclose _pclose
+#endif
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	ComputeShaderWatcher::ComputeShaderWatcher(int interval)
+	{
+		_interval = interval;
+		// looked up on the PATH, where the Vulkan SDK installer puts it
+		_compilerPath = "glslangValidator";
+		_running = true;
+		_thread = std::thread(&ComputeShaderWatcher::run, this);
+	}
+
+	ComputeShaderWatcher::~ComputeShaderWatcher()
+	{
+		_running = false;
+		if (_thread.joinable())
+		{
+			_thread.join();
+		}
+	}
+
+	shared_ptr<ComputeShaderWatcher> ComputeShaderWatcher::Get()
+	{
+		static shared_ptr<ComputeShaderWatcher> watcher = make_shared<ComputeShaderWatcher>(250);
+		return watcher;
+	}
+
+	void ComputeShaderWatcher::Watch(shared_ptr<ComputeShader> shader, const WString& sourcePath)
+	{
+		WatchEntry entry;
+		entry.shader = shader;
+		entry.source = std::filesystem::path(std::wstring(sourcePath));
+
+		std::error_code error;
+		entry.lastWrite = std::filesystem::last_write_time(entry.source, error);
+		if (error)
+		{
+			Print("Error: Compute shader source not found: " + entry.source.string());
+		}
+
+		std::lock_guard<std::mutex> lock(_mutex);
+		_entries.push_back(entry);
+	}
+
+	void ComputeShaderWatcher::Unwatch(shared_ptr<ComputeShader> shader)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for (int i = _entries.size() - 1; i >= 0; i--)
+		{
+			if (_entries[i].shader.lock() == shader)
+			{
+				_entries.erase(_entries.begin() + i);
+			}
+		}
+	}
+
+	void ComputeShaderWatcher::SetCompilerPath(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_compilerPath = path;
+	}
+
+	void ComputeShaderWatcher::run()
+	{
+		while (_running)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(_interval));
+
+			vector<pair<shared_ptr<ComputeShader>, std::filesystem::path>> changed;
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				for (int i = _entries.size() - 1; i >= 0; i--)
+				{
+					auto shader = _entries[i].shader.lock();
+					if (shader == nullptr)
+					{
+						_entries.erase(_entries.begin() + i);
+						continue;
+					}
+
+					std::error_code error;
+					auto lastWrite = std::filesystem::last_write_time(_entries[i].source, error);
+					if (error || lastWrite == _entries[i].lastWrite)
+					{
+						continue;
+					}
+
+					_entries[i].lastWrite = lastWrite;
+					changed.push_back({ shader, _entries[i].source });
+				}
+			}
+
+			for (auto& entry : changed)
+			{
+				vector<uint32_t> spirv;
+				if (compile(entry.second, spirv) && entry.first->Reload(spirv))
+				{
+					Print("Reloaded compute shader: " + entry.second.string());
+				}
+			}
+		}
+	}
+
+	bool ComputeShaderWatcher::compile(const std::filesystem::path& source, vector<uint32_t>& spirv)
+	{
+		std::string compiler;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			compiler = _compilerPath;
+		}
+
+		// compiled next to the other temporary files, the tracked .spv files are left alone. The hash of the full path
+		// keeps sources with the same name in different folders apart.
+		std::error_code error;
+		auto output = std::filesystem::temp_directory_path(error);
+		if (error)
+		{
+			Print("Error: No temporary folder for the compiled shader " + source.string());
+			return false;
+		}
+		output /= source.filename().string() + "." + std::to_string(std::hash<std::string>()(std::filesystem::absolute(source, error).string())) + ".spv";
+
+		std::string command = "\"" + compiler + "\" -V \"" + source.string() + "\" -o \"" + output.string() + "\" 2>&1";
+#if defined(_WIN32)
+		// cmd removes the outer quotes of the whole command line
+		command = "\"" + command + "\"";
+#endif
+
+		FILE* pipe = popen(command.c_str(), "r");
+		if (pipe == nullptr)
+		{
+			Print("Error: Failed to start the shader compiler: " + compiler);
+			return false;
+		}
+
+		std::string log;
+		char buffer[256];
+		while (fgets(buffer, sizeof(buffer), pipe) != nullptr)
+		{
+			log += buffer;
+		}
+
+		if (pclose(pipe) != 0)
+		{
+			Print("Error: Failed to compile " + source.string() + ", keeping the previous pipeline\n" + log);
+			return false;
+		}
+
+		std::ifstream file(output, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+		{
+			return false;
+		}
+
+		size_t size = file.tellg();
+		if (size == 0 || size % sizeof(uint32_t) != 0)
+		{
+			return false;
+		}
+
+		spirv.resize(size / sizeof(uint32_t));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(spirv.data()), size);
+		return file.good();
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "UltraEngine.h"
+#include "ComputeShader.h"
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	/// <summary>
+	/// Watches compute shader sources and reloads the shaders when a source changes.
+	/// Compilation to SPIR-V and the pipeline creation happen on a background thread, the new pipeline is swapped in
+	/// at the next frame boundary. If the compilation fails the shader keeps running with its previous pipeline.
+	/// </summary>
+	class ComputeShaderWatcher : public Object
+	{
+	private:
+		struct WatchEntry
+		{
+			weak_ptr<ComputeShader> shader;
+			std::filesystem::path source;
+			std::filesystem::file_time_type lastWrite;
+		};
+
+		std::mutex _mutex;
+		vector<WatchEntry> _entries;
+		std::thread _thread;
+		std::atomic<bool> _running;
+		int _interval;
+		std::string _compilerPath;
+
+		void run();
+		bool compile(const std::filesystem::path& source, vector<uint32_t>& spirv);
+
+	public:
+		ComputeShaderWatcher(int interval);
+		virtual ~ComputeShaderWatcher();
+
+		static shared_ptr<ComputeShaderWatcher> Get();
+
+		// Reloads the shader whenever the GLSL source file changes
+		void Watch(shared_ptr<ComputeShader> shader, const WString& sourcePath);
+		void Unwatch(shared_ptr<ComputeShader> shader);
+
+		// Path of the glslangValidator executable, defaults to "glslangValidator" looked up on the PATH
+		void SetCompilerPath(const std::string& path);
+	};
+}
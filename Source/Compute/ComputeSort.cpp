@@ -0,0 +1,135 @@
+#include "UltraEngine.h"
+#include "ComputeSort.h"
+#include "Generated/EmbeddedShaders.h"
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	// must match Shaders/Compute/radix_sort.comp
+	enum SortMode
+	{
+		SORT_MODE_SETUP = 0,
+		SORT_MODE_HISTOGRAM = 1,
+		SORT_MODE_SCATTER = 2
+	};
+
+	enum SortFlags
+	{
+		SORT_FLAG_INDIRECT = 1,
+		SORT_FLAG_VALUES = 2,
+		SORT_FLAG_COPY = 4
+	};
+
+	ComputeSort::ComputeSort(shared_ptr<ComputeStorageBuffer> keys, shared_ptr<ComputeStorageBuffer> values, uint32_t maxCount, shared_ptr<ComputeStorageBuffer> countBuffer, uint32_t countIndex)
+	{
+		_keys = keys;
+		_values = values;
+		_maxCount = maxCount;
+		_maxBlocks = std::max((maxCount + BLOCK_SIZE - 1) / BLOCK_SIZE, 1u);
+		_countIndex = countIndex;
+
+		_tempKeys = ComputeStorageBuffer::Create(std::max(maxCount, 1u) * sizeof(uint32_t));
+		_histogram = ComputeStorageBuffer::Create((1 << RADIX_BITS) * _maxBlocks * sizeof(uint32_t));
+		_offsets = ComputeStorageBuffer::Create((1 << RADIX_BITS) * _maxBlocks * sizeof(uint32_t));
+		_state = ComputeStorageBuffer::Create(4 * sizeof(uint32_t));
+		_scan = ComputeScan::Create(_histogram, _offsets, (1 << RADIX_BITS) * _maxBlocks);
+
+		// unused bindings still need a buffer
+		_countBuffer = countBuffer != nullptr ? countBuffer : _state;
+		shared_ptr<ComputeStorageBuffer> values0 = _state, values1 = _state;
+		if (_values != nullptr)
+		{
+			_tempValues = ComputeStorageBuffer::Create(std::max(maxCount, 1u) * sizeof(uint32_t));
+			values0 = _values;
+			values1 = _tempValues;
+		}
+
+		shared_ptr<ComputeStorageBuffer> keys0 = _keys, keys1 = _tempKeys;
+		for (int direction = 0; direction < 2; direction++)
+		{
+			auto shader = ComputeShader::CreateFromMemory(EmbeddedShaders::radix_sort, sizeof(EmbeddedShaders::radix_sort));
+			shader->AddStorageBuffer(direction == 0 ? keys0 : keys1);
+			shader->AddStorageBuffer(direction == 0 ? keys1 : keys0);
+			shader->AddStorageBuffer(direction == 0 ? values0 : values1);
+			shader->AddStorageBuffer(direction == 0 ? values1 : values0);
+			shader->AddStorageBuffer(_histogram);
+			shader->AddStorageBuffer(_offsets);
+			shader->AddStorageBuffer(_state);
+			shader->AddStorageBuffer(_countBuffer);
+			shader->SetupPushConstant(sizeof(ComputeSortConstants));
+			_shaders[direction] = shader;
+		}
+	}
+
+	shared_ptr<ComputeSort> ComputeSort::Create(shared_ptr<ComputeStorageBuffer> keys, shared_ptr<ComputeStorageBuffer> values, uint32_t maxCount, shared_ptr<ComputeStorageBuffer> countBuffer, uint32_t countIndex)
+	{
+		return make_shared<ComputeSort>(keys, values, maxCount, countBuffer, countIndex);
+	}
+
+	void ComputeSort::Dispatch(shared_ptr<World> world, uint32_t count, int keyBits, ComputeHook hook)
+	{
+		count = std::min(count, _maxCount);
+		if (count < 2)
+		{
+			return;
+		}
+		dispatch(world, count, false, keyBits, hook);
+	}
+
+	void ComputeSort::DispatchIndirect(shared_ptr<World> world, int keyBits, ComputeHook hook)
+	{
+		if (_countBuffer == _state)
+		{
+			Print("Error: ComputeSort::DispatchIndirect needs a count buffer");
+			return;
+		}
+		dispatch(world, 0, true, keyBits, hook);
+	}
+
+	void ComputeSort::dispatch(shared_ptr<World> world, uint32_t count, bool indirect, int keyBits, ComputeHook hook)
+	{
+		// an even number of passes brings the result back to the original buffers, an extra pass over a zero digit is a stable copy
+		keyBits = std::clamp(keyBits, 1, 32);
+		int passCount = (keyBits + RADIX_BITS - 1) / RADIX_BITS;
+		passCount += passCount & 1;
+
+		ComputeSortConstants constants = {};
+		constants.maxCount = _maxCount;
+		constants.stride = _maxBlocks;
+		constants.count = count;
+		constants.countIndex = _countIndex;
+		constants.flags = (indirect ? SORT_FLAG_INDIRECT : 0) | (_values != nullptr ? SORT_FLAG_VALUES : 0);
+
+		auto passes = ComputePassList::Create();
+
+		int tx, ty;
+		constants.mode = SORT_MODE_SETUP;
+		GetDispatchGrid(((1 << RADIX_BITS) * _maxBlocks + 255) / 256, tx, ty);
+		passes->Add(_shaders[0], tx, ty, 1, &constants, sizeof(constants));
+
+		for (int pass = 0; pass < passCount; pass++)
+		{
+			auto shader = _shaders[pass & 1];
+			constants.shift = pass * RADIX_BITS;
+			if (pass * RADIX_BITS >= keyBits)
+			{
+				// the padding pass treats every key as digit 0
+				constants.flags |= SORT_FLAG_COPY;
+			}
+
+			constants.mode = SORT_MODE_HISTOGRAM;
+			passes->AddIndirect(shader, _state, 0, &constants, sizeof(constants));
+
+			// the whole histogram is scanned, the rows of blocks past the count were cleared by the setup pass
+			_scan->AddPasses(passes, (1 << RADIX_BITS) * _maxBlocks, false);
+
+			constants.mode = SORT_MODE_SCATTER;
+			passes->AddIndirect(shader, _state, 0, &constants, sizeof(constants));
+		}
+
+		_lastPasses = passes;
+		passes->BeginDispatch(world, hook);
+	}
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "UltraEngine.h"
+#include "ComputeShader.h"
+#include "ComputePass.h"
+#include "ComputePrimitives.h"
+#include "ComputeStorageBuffer.h"
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	// Push constants of Shaders/Compute/radix_sort.comp
+	struct ComputeSortConstants
+	{
+		uint32_t mode;
+		uint32_t shift;
+		uint32_t maxCount;
+		uint32_t stride;
+		uint32_t count;
+		uint32_t flags;
+		uint32_t countIndex;
+	};
+
+	/// <summary>
+	/// Stable LSD radix sort of 32 bit unsigned keys with optional 32 bit values, e.g. particle depths with particle indices
+	/// or spatial hash cells with point indices. Every pass sorts by 4 bits: a histogram of the digits per block of 1024 keys,
+	/// an exclusive scan of the histogram (ComputeScan) and a stable scatter. The passes alternate between the buffers and
+	/// internal copies, the result always ends up in the buffers given to Create.
+	/// The block passes are dispatched indirectly, so the element count can be written by an earlier pass on the GPU,
+	/// e.g. the count of a ComputeCompact at index 0 of its result buffer. Float keys have to be mapped to ordered
+	/// unsigned integers first (flip all bits of negative values, only the sign bit of positive ones).
+	/// </summary>
+	class ComputeSort : public Object
+	{
+	private:
+		// [0] sorts from the buffers into the copies, [1] back again
+		shared_ptr<ComputeShader> _shaders[2];
+		shared_ptr<ComputeScan> _scan;
+		shared_ptr<ComputeStorageBuffer> _keys;
+		shared_ptr<ComputeStorageBuffer> _values;
+		shared_ptr<ComputeStorageBuffer> _tempKeys;
+		shared_ptr<ComputeStorageBuffer> _tempValues;
+		shared_ptr<ComputeStorageBuffer> _histogram;
+		shared_ptr<ComputeStorageBuffer> _offsets;
+		// indirect group counts and the element count of the current sort
+		shared_ptr<ComputeStorageBuffer> _state;
+		shared_ptr<ComputeStorageBuffer> _countBuffer;
+		uint32_t _countIndex;
+		uint32_t _maxCount;
+		uint32_t _maxBlocks;
+		shared_ptr<ComputePassList> _lastPasses;
+
+		void dispatch(shared_ptr<World> world, uint32_t count, bool indirect, int keyBits, ComputeHook hook);
+
+	public:
+		static constexpr uint32_t BLOCK_SIZE = 1024;
+		static constexpr int RADIX_BITS = 4;
+
+		ComputeSort(shared_ptr<ComputeStorageBuffer> keys, shared_ptr<ComputeStorageBuffer> values, uint32_t maxCount, shared_ptr<ComputeStorageBuffer> countBuffer, uint32_t countIndex);
+		// values may be nullptr to sort the keys only. countBuffer holds the element count at countIndex for DispatchIndirect.
+		static shared_ptr<ComputeSort> Create(shared_ptr<ComputeStorageBuffer> keys, shared_ptr<ComputeStorageBuffer> values, uint32_t maxCount, shared_ptr<ComputeStorageBuffer> countBuffer = nullptr, uint32_t countIndex = 0);
+
+		// Sorts the first count keys. Only the lowest keyBits bits are compared, fewer bits need fewer passes.
+		void Dispatch(shared_ptr<World> world, uint32_t count, int keyBits = 32, ComputeHook hook = ComputeHook::TRANSFER);
+		// Sorts as many keys as the count buffer holds when the passes run, clamped to maxCount
+		void DispatchIndirect(shared_ptr<World> world, int keyBits = 32, ComputeHook hook = ComputeHook::TRANSFER);
+
+		// The passes of the last dispatch, their timer measures the whole sort
+		shared_ptr<ComputePassList> GetLastPasses() { return _lastPasses; }
+	};
+}
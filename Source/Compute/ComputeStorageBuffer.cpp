@@ -0,0 +1,187 @@
+#include "UltraEngine.h"
+#include "ComputeStorageBuffer.h"
+#include "ComputeContext.h"
+#include "ComputeUploader.h"
+#include <atomic>
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	static std::atomic<bool> DeviceAddresses = false;
+
+	ComputeStorageBuffer::ComputeStorageBuffer(size_t size, const void* data, bool deviceLocal)
+	{
+		_size = size;
+
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		// without the feature enabled on the device the usage flag is invalid
+		if (DeviceAddresses)
+		{
+			usage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+		}
+
+		if (deviceLocal)
+		{
+			auto uploader = ComputeUploader::Get();
+			VK_CHECK_RESULT(initializers::createBuffer(usage, uploader->GetTargetMemory(), &_buffer, size, nullptr));
+
+			vector<uint8_t> zeros;
+			if (data == nullptr)
+			{
+				zeros.resize(size, 0);
+				data = zeros.data();
+			}
+			uploader->Write(_buffer, data, size);
+			return;
+		}
+
+		// the memory may not be host coherent, SetData and GetData flush and invalidate what they access
+		VK_CHECK_RESULT(initializers::createBuffer(usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &_buffer, size, data));
+
+		if (data == nullptr)
+		{
+			_buffer.map();
+			memset(_buffer.mapped, 0, size);
+			if (!_buffer.isCoherent())
+			{
+				_buffer.flush();
+			}
+			_buffer.unmap();
+		}
+	}
+
+	ComputeStorageBuffer::ComputeStorageBuffer(size_t size)
+	{
+		_size = size;
+		_ownsMemory = false;
+
+		auto device = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device;
+		_buffer.device = device->device;
+		_buffer.size = size;
+		_buffer.usageFlags = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		_buffer.memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+		VkBufferCreateInfo bufferCreateInfo = initializers::bufferCreateInfo(_buffer.usageFlags, size);
+		bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VK_CHECK_RESULT(vkCreateBuffer(device->device, &bufferCreateInfo, nullptr, &_buffer.buffer));
+		_buffer.setupDescriptor();
+	}
+
+	ComputeStorageBuffer::~ComputeStorageBuffer()
+	{
+		// dispatches of the last frames may still read the buffer
+		ComputeBuffer buffer = _buffer;
+		if (!_ownsMemory)
+		{
+			buffer.memory = VK_NULL_HANDLE;
+		}
+		ComputeContext::Get()->Retire(buffer);
+	}
+
+	shared_ptr<ComputeStorageBuffer> ComputeStorageBuffer::Create(size_t size, const void* data)
+	{
+		return make_shared<ComputeStorageBuffer>(size, data);
+	}
+
+	shared_ptr<ComputeStorageBuffer> ComputeStorageBuffer::CreateDeviceLocal(size_t size, const void* data)
+	{
+		return make_shared<ComputeStorageBuffer>(size, data, true);
+	}
+
+	shared_ptr<ComputeStorageBuffer> ComputeStorageBuffer::CreateUnbound(size_t size)
+	{
+		return make_shared<ComputeStorageBuffer>(size);
+	}
+
+	VkMemoryRequirements ComputeStorageBuffer::GetMemoryRequirements() const
+	{
+		VkMemoryRequirements requirements;
+		vkGetBufferMemoryRequirements(_buffer.device, _buffer.buffer, &requirements);
+		return requirements;
+	}
+
+	void ComputeStorageBuffer::BindMemory(VkDeviceMemory memory, VkDeviceSize offset)
+	{
+		if (_ownsMemory)
+		{
+			Print("Error: ComputeStorageBuffer::BindMemory is only valid for buffers created with CreateUnbound");
+			return;
+		}
+
+		_buffer.memory = memory;
+		VK_CHECK_RESULT(_buffer.bind(offset));
+	}
+
+	bool ComputeStorageBuffer::IsSupported()
+	{
+		VkPhysicalDevice physicalDevice = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device->physicaldevice;
+
+		VkPhysicalDeviceBufferDeviceAddressFeatures addressFeatures{};
+		addressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+		VkPhysicalDeviceFeatures2 features{};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &addressFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+		return addressFeatures.bufferDeviceAddress;
+	}
+
+	bool ComputeStorageBuffer::EnableDeviceAddresses(bool enable)
+	{
+		if (enable && !IsSupported())
+		{
+			Print("Error: The device does not support buffer device addresses");
+			DeviceAddresses = false;
+			return false;
+		}
+		DeviceAddresses = enable;
+		return true;
+	}
+
+	bool ComputeStorageBuffer::HasDeviceAddresses()
+	{
+		return DeviceAddresses;
+	}
+
+	VkDeviceAddress ComputeStorageBuffer::GetDeviceAddress() const
+	{
+		return _buffer.GetDeviceAddress();
+	}
+
+	void ComputeStorageBuffer::SetData(const void* data, size_t size, size_t offset)
+	{
+		if (size == 0)
+		{
+			return;
+		}
+		if (!_ownsMemory)
+		{
+			Print("Error: ComputeStorageBuffer::SetData is not available for unbound buffers");
+			return;
+		}
+
+		ComputeUploader::Get()->Write(_buffer, data, size, offset);
+	}
+
+	void ComputeStorageBuffer::GetData(void* data, size_t size, size_t offset)
+	{
+		if (size == 0)
+		{
+			return;
+		}
+		if (!_ownsMemory)
+		{
+			Print("Error: ComputeStorageBuffer::GetData is not available for unbound buffers");
+			return;
+		}
+
+		if ((_buffer.memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0)
+		{
+			Print("Error: ComputeStorageBuffer::GetData is not available for device local memory");
+			return;
+		}
+		_buffer.read(data, size, offset);
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+#include "UltraEngine.h"
+#include "VulkanUtils.h"
+
+using namespace UltraEngine;
+using namespace UltraEngine::Compute::Utils;
+
+namespace UltraEngine::Compute
+{
+	/// <summary>
+	/// Storage buffer owned by the application, which can be bound to any number of shaders or addressed directly.
+	/// The buffer has a device address, so kernels using GL_EXT_buffer_reference can reach it (and structures linked
+	/// through addresses stored inside it) without any descriptor:
+	///
+	///   layout (buffer_reference, std430) buffer Nodes { Node nodes[]; };
+	///   layout (push_constant) uniform Constants { Nodes nodes; } params;
+	///
+	/// with the address from GetDeviceAddress() stored as uint64_t in the push constants on the C++ side.
+	/// See Shaders/Compute/buffer_reference_sum.comp. Device addresses are off until EnableDeviceAddresses is called.
+	/// The buffer can also hold the arguments of indirect dispatches (see ComputePassList::AddIndirect).
+	/// </summary>
+	class ComputeStorageBuffer : public Object
+	{
+	private:
+		ComputeBuffer _buffer;
+		size_t _size;
+		// unbound buffers live in memory owned by someone else
+		bool _ownsMemory = true;
+
+	public:
+		ComputeStorageBuffer(size_t size, const void* data, bool deviceLocal = false);
+		ComputeStorageBuffer(size_t size);
+		virtual ~ComputeStorageBuffer();
+
+		// Without data the buffer is zero initialized
+		static shared_ptr<ComputeStorageBuffer> Create(size_t size, const void* data = nullptr);
+		// Buffer in device local memory, which shaders read much faster on discrete GPUs. SetData goes through the
+		// ComputeUploader and arrives with the next frame, GetData is only available where the memory is host visible.
+		static shared_ptr<ComputeStorageBuffer> CreateDeviceLocal(size_t size, const void* data = nullptr);
+		// Device local buffer without memory, the owner binds it to a range of its own allocation with BindMemory before
+		// the first dispatch using it, e.g. to alias buffers which are never used at the same time (see ComputeGraph).
+		// The buffer can not be read or written by the CPU and has no device address.
+		static shared_ptr<ComputeStorageBuffer> CreateUnbound(size_t size);
+
+		// Returns if the physical device supports buffer device addresses. That alone does not make them usable, the
+		// feature also has to be enabled on the logical device, see EnableDeviceAddresses.
+		static bool IsSupported();
+		// The engine creates the Vulkan device and whether it enabled bufferDeviceAddress can not be queried, so buffers
+		// only get an address after the application confirmed it with EnableDeviceAddresses(true). Affects the buffers
+		// created afterwards. Returns false, and stays disabled, if the physical device does not support the feature.
+		static bool EnableDeviceAddresses(bool enable);
+		static bool HasDeviceAddresses();
+
+		// 0 if the buffer was created without device addresses enabled
+		VkDeviceAddress GetDeviceAddress() const;
+		size_t GetSize() const { return _size; }
+		ComputeBuffer& GetBuffer() { return _buffer; }
+		VkMemoryRequirements GetMemoryRequirements() const;
+		// Binds an unbound buffer, the memory has to outlive the buffer
+		void BindMemory(VkDeviceMemory memory, VkDeviceSize offset);
+
+		// Written through the ComputeUploader, host visible buffers as well, the frames in flight may still read them.
+		// The data is seen by the dispatches of the next frame.
+		void SetData(const void* data, size_t size, size_t offset = 0);
+		// Reads back what the GPU has written, only valid once the dispatches writing it have completed
+		void GetData(void* data, size_t size, size_t offset = 0);
+	};
+}
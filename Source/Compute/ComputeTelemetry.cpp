@@ -0,0 +1,282 @@
+#include "UltraEngine.h"
+#include "ComputeTelemetry.h"
+#include <cstdio>
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	static const char* CompileStateNames[] = { "idle", "compiling", "ready", "failed" };
+
+	static string FormatFixed(double value, int decimals)
+	{
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer), "%.*f", decimals, value);
+		return buffer;
+	}
+
+	// Quoted CSV field, quotes inside are doubled
+	static string QuoteCsv(const string& value)
+	{
+		string result = "\"";
+		for (char c : value)
+		{
+			if (c == '"')
+			{
+				result += '"';
+			}
+			result += c;
+		}
+		return result + "\"";
+	}
+
+	ComputeTelemetry::ComputeTelemetry(shared_ptr<World> world, shared_ptr<Font> font, int fontSize, int renderLayers)
+	{
+		_world = world;
+		_font = font;
+		_fontSize = fontSize;
+		_renderLayers = renderLayers;
+		_start = std::chrono::steady_clock::now();
+		_lastSample = _start;
+	}
+
+	ComputeTelemetry::~ComputeTelemetry()
+	{
+		StopLog();
+	}
+
+	shared_ptr<ComputeTelemetry> ComputeTelemetry::Create(shared_ptr<World> world, shared_ptr<Font> font, int fontSize, int renderLayers)
+	{
+		auto telemetry = make_shared<ComputeTelemetry>(world, font, fontSize, renderLayers);
+		if (font != nullptr)
+		{
+			telemetry->_sprite = CreateSprite(world, font, telemetry->GetText(), fontSize);
+			telemetry->_sprite->SetRenderLayers(renderLayers);
+			telemetry->_sprite->SetPosition(telemetry->_position.x, telemetry->_position.y);
+		}
+		return telemetry;
+	}
+
+	void ComputeTelemetry::Add(shared_ptr<ComputeShader> shader)
+	{
+		for (auto& entry : _entries)
+		{
+			if (entry.shader.lock() == shader)
+			{
+				return;
+			}
+		}
+
+		Entry entry;
+		entry.shader = shader;
+		entry.sample.name = shader->GetName();
+		entry.sample.totalDispatches = shader->CountDispatches();
+		entry.sample.totalDescriptorWrites = shader->CountDescriptorWrites();
+		entry.sample.totalBytesUploaded = shader->GetBytesUploaded();
+		entry.sample.state = shader->GetCompileState();
+		_entries.push_back(entry);
+	}
+
+	void ComputeTelemetry::Remove(shared_ptr<ComputeShader> shader)
+	{
+		for (int i = 0; i < _entries.size(); i++)
+		{
+			if (_entries[i].shader.lock() == shader)
+			{
+				_entries.erase(_entries.begin() + i);
+				return;
+			}
+		}
+	}
+
+	void ComputeTelemetry::SetRenderLayers(int renderLayers)
+	{
+		_renderLayers = renderLayers;
+		if (_sprite != nullptr)
+		{
+			_sprite->SetRenderLayers(renderLayers);
+		}
+	}
+
+	void ComputeTelemetry::SetPosition(float x, float y)
+	{
+		_position = Vec2(x, y);
+		if (_sprite != nullptr)
+		{
+			_sprite->SetPosition(x, y);
+		}
+	}
+
+	void ComputeTelemetry::sample(double seconds)
+	{
+		_samples.clear();
+		for (int i = 0; i < _entries.size(); i++)
+		{
+			auto shader = _entries[i].shader.lock();
+			if (shader == nullptr)
+			{
+				_entries.erase(_entries.begin() + i);
+				i--;
+				continue;
+			}
+
+			auto& sample = _entries[i].sample;
+			sample.name = shader->GetName();
+			sample.state = shader->GetCompileState();
+
+			// the timestamps of a dispatch still in flight are not waited for, the last time is shown until they arrive
+			auto timer = shader->GetQueryTimer();
+			std::array<uint64_t, 2> timestamps = { 0, 0 };
+			if (timer != nullptr && timer->TryGetQueryPoolResults(timestamps) && timestamps[1] >= timestamps[0])
+			{
+				sample.gpuMilliseconds = double(timestamps[1] - timestamps[0]) * timer->GetPeriod() / 1e+6;
+			}
+
+			uint64_t dispatches = shader->CountDispatches();
+			uint64_t descriptorWrites = shader->CountDescriptorWrites();
+			uint64_t bytesUploaded = shader->GetBytesUploaded();
+			sample.dispatches = double(dispatches - sample.totalDispatches) / seconds;
+			sample.descriptorWrites = double(descriptorWrites - sample.totalDescriptorWrites) / seconds;
+			sample.bytesUploaded = double(bytesUploaded - sample.totalBytesUploaded) / seconds;
+			sample.totalDispatches = dispatches;
+			sample.totalDescriptorWrites = descriptorWrites;
+			sample.totalBytesUploaded = bytesUploaded;
+
+			_samples.push_back(sample);
+		}
+	}
+
+	string ComputeTelemetry::GetText() const
+	{
+		string text = "Compute telemetry";
+		auto world = _world.lock();
+		if (world != nullptr)
+		{
+			text += " - FPS " + std::to_string(int(world->renderstats.framerate));
+		}
+		text += "\n";
+
+		for (auto& sample : _samples)
+		{
+			text += sample.name + ": " + FormatFixed(sample.gpuMilliseconds, 3) + " ms, "
+				+ FormatFixed(sample.dispatches, 0) + " dispatches/s, "
+				+ FormatFixed(sample.descriptorWrites, 0) + " descriptor writes/s, "
+				+ FormatFixed(sample.bytesUploaded / 1024.0, 1) + " KB/s uploaded, "
+				+ CompileStateNames[int(sample.state)] + "\n";
+		}
+		return text;
+	}
+
+	void ComputeTelemetry::updateOverlay()
+	{
+		if (_sprite == nullptr)
+		{
+			return;
+		}
+		_sprite->SetText(GetText());
+	}
+
+	bool ComputeTelemetry::StartLog(const string& path)
+	{
+		StopLog();
+
+		_logFile.open(path, std::ios::out | std::ios::app);
+		if (!_logFile.is_open())
+		{
+			Print("Error: Failed to open compute telemetry log " + path);
+			return false;
+		}
+		// appending to an earlier log continues its table
+		_logFile.seekp(0, std::ios::end);
+		if (_logFile.tellp() == 0)
+		{
+			_logFile << "time_ms,shader,gpu_ms,dispatches,descriptor_writes,bytes_uploaded,state\n";
+		}
+
+		_logging = true;
+		_logThread = std::thread(&ComputeTelemetry::writeLog, this);
+		return true;
+	}
+
+	void ComputeTelemetry::StopLog()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_logMutex);
+			if (!_logging)
+			{
+				return;
+			}
+			_logging = false;
+		}
+		_logCondition.notify_all();
+		if (_logThread.joinable())
+		{
+			_logThread.join();
+		}
+		_logFile.close();
+	}
+
+	void ComputeTelemetry::writeLog()
+	{
+		while (true)
+		{
+			std::deque<string> lines;
+			bool logging;
+			{
+				std::unique_lock<std::mutex> lock(_logMutex);
+				_logCondition.wait(lock, [this]() { return !_logging || !_logLines.empty(); });
+				lines.swap(_logLines);
+				logging = _logging;
+			}
+
+			// lines queued before StopLog are still written
+			for (auto& line : lines)
+			{
+				_logFile << line;
+			}
+			_logFile.flush();
+
+			if (!logging)
+			{
+				return;
+			}
+		}
+	}
+
+	void ComputeTelemetry::Update()
+	{
+		auto now = std::chrono::steady_clock::now();
+		if (now - _lastSample < std::chrono::milliseconds(_interval))
+		{
+			return;
+		}
+		double seconds = std::chrono::duration<double>(now - _lastSample).count();
+		_lastSample = now;
+
+		sample(seconds);
+		updateOverlay();
+
+		if (!_logging)
+		{
+			return;
+		}
+
+		string time = std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(now - _start).count());
+		std::deque<string> lines;
+		for (auto& sample : _samples)
+		{
+			lines.push_back(time + "," + QuoteCsv(sample.name) + "," + FormatFixed(sample.gpuMilliseconds, 4) + ","
+				+ std::to_string(sample.totalDispatches) + "," + std::to_string(sample.totalDescriptorWrites) + ","
+				+ std::to_string(sample.totalBytesUploaded) + "," + CompileStateNames[int(sample.state)] + "\n");
+		}
+		{
+			std::lock_guard<std::mutex> lock(_logMutex);
+			for (auto& line : lines)
+			{
+				_logLines.push_back(std::move(line));
+			}
+		}
+		_logCondition.notify_one();
+	}
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "UltraEngine.h"
+#include "ComputeShader.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	struct ComputeShaderTelemetry
+	{
+		string name;
+		// GPU time of the last dispatch the timestamps are available for
+		double gpuMilliseconds = 0;
+		// per second, over the last sample interval
+		double dispatches = 0;
+		double descriptorWrites = 0;
+		double bytesUploaded = 0;
+		// totals since the shader was created
+		uint64_t totalDispatches = 0;
+		uint64_t totalDescriptorWrites = 0;
+		uint64_t totalBytesUploaded = 0;
+		ComputeCompileState state = ComputeCompileState::NONE;
+	};
+
+	/// <summary>
+	/// Collects the cost of the added compute shaders: GPU time, dispatches, descriptor writes, uploaded bytes and the
+	/// state of the pipeline. Every interval the values are sampled and shown as a text sprite on the render layers of a
+	/// 2D camera, and written to a CSV file if a log was started. Between samples Update only checks the clock, and the
+	/// file is written on a background thread, so the telemetry can stay on in production builds.
+	/// Timestamps are read without waiting for the GPU; until a dispatch has completed the last known time is kept.
+	/// </summary>
+	class ComputeTelemetry : public Object
+	{
+	private:
+		struct Entry
+		{
+			weak_ptr<ComputeShader> shader;
+			ComputeShaderTelemetry sample;
+		};
+
+		weak_ptr<World> _world;
+		vector<Entry> _entries;
+		vector<ComputeShaderTelemetry> _samples;
+
+		shared_ptr<Font> _font;
+		int _fontSize;
+		int _renderLayers;
+		Vec2 _position = Vec2(20, 20);
+		shared_ptr<Sprite> _sprite;
+
+		std::chrono::steady_clock::time_point _start;
+		std::chrono::steady_clock::time_point _lastSample;
+		int _interval = 500;
+
+		// CSV log
+		std::mutex _logMutex;
+		std::condition_variable _logCondition;
+		std::deque<string> _logLines;
+		std::ofstream _logFile;
+		std::thread _logThread;
+		bool _logging = false;
+
+		void sample(double seconds);
+		void updateOverlay();
+		void writeLog();
+
+	public:
+		ComputeTelemetry(shared_ptr<World> world, shared_ptr<Font> font, int fontSize, int renderLayers);
+		virtual ~ComputeTelemetry();
+
+		// The overlay is drawn by a camera which renders renderLayers, e.g. an orthographic camera with CLEAR_DEPTH.
+		// Without a font there is no overlay.
+		static shared_ptr<ComputeTelemetry> Create(shared_ptr<World> world, shared_ptr<Font> font, int fontSize = 14, int renderLayers = 1);
+
+		void Add(shared_ptr<ComputeShader> shader);
+		void Remove(shared_ptr<ComputeShader> shader);
+
+		void SetRenderLayers(int renderLayers);
+		void SetPosition(float x, float y);
+		// Milliseconds between samples, 500 by default
+		void SetInterval(int milliseconds) { _interval = std::max(1, milliseconds); }
+
+		// Appends one line per shader and sample to the file, a new or empty file gets a header line first. The counters
+		// are written as totals so samples can be dropped or merged afterwards. Returns false if the file can't be opened.
+		bool StartLog(const string& path);
+		void StopLog();
+
+		// Values of the last sample, in the order the shaders were added
+		const vector<ComputeShaderTelemetry>& GetSamples() const { return _samples; }
+		string GetText() const;
+
+		// Call once per frame from the game loop. Shaders which were deleted are removed.
+		void Update();
+	};
+}
@@ -0,0 +1,91 @@
+#include "UltraEngine.h"
+#include "ComputeTiledDispatch.h"
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	ComputeTiledDispatch::ComputeTiledDispatch(shared_ptr<ComputeShader> shader, int tx, int ty, int tz, int tileX, int tileY, int tileZ, int tilesPerFrame, const void* pushData, size_t pushDataSize)
+	{
+		_shader = shader;
+		_tilesPerFrame = tilesPerFrame;
+		_completion = ComputeCompletion::Create();
+		_pushConstantsSize = std::min(pushDataSize, sizeof(_pushConstants));
+		if (pushData != nullptr)
+		{
+			memcpy(_pushConstants, pushData, _pushConstantsSize);
+		}
+
+		tileX = std::max(tileX, 1);
+		tileY = std::max(tileY, 1);
+		tileZ = std::max(tileZ, 1);
+		for (int z = 0; z < tz; z += tileZ)
+		{
+			for (int y = 0; y < ty; y += tileY)
+			{
+				for (int x = 0; x < tx; x += tileX)
+				{
+					ComputeTile tile;
+					tile.x = x;
+					tile.y = y;
+					tile.z = z;
+					tile.tx = std::min(tileX, tx - x);
+					tile.ty = std::min(tileY, ty - y);
+					tile.tz = std::min(tileZ, tz - z);
+					_tiles.push_back(tile);
+				}
+			}
+		}
+	}
+
+	bool ComputeTiledDispatch::Record(VkCommandBuffer commandBuffer)
+	{
+		uint32_t first = _recorded;
+		if (_cancelled || first >= _tiles.size())
+		{
+			_completion->Signal();
+			return false;
+		}
+
+		uint32_t count = _tiles.size() - first;
+		if (_tilesPerFrame > 0)
+		{
+			count = std::min(count, uint32_t(_tilesPerFrame));
+		}
+
+		// frames pass until the pipeline is ready, unless the shader wants to wait for it
+		if (_shader->GetCompilePolicy() != ComputeCompilePolicy::BLOCK && _shader->GetCompileState() == ComputeCompileState::COMPILING)
+		{
+			return true;
+		}
+
+		// the first frame starts like any dispatch, the following ones keep the images written so far
+		if (!_shader->DispatchTiles(commandBuffer, &_tiles[first], count, first > 0 ? ComputeImageSync::PRESERVE : ComputeImageSync::DISCARD, _pushConstantsSize > 0 ? _pushConstants : nullptr, _pushConstantsSize, 0))
+		{
+			// the pipeline failed
+			_cancelled = true;
+			_completion->Signal();
+			return false;
+		}
+
+		_lastFrame = ComputeContext::Get()->GetFrame();
+		_recorded = first + count;
+		if (_recorded == _tiles.size())
+		{
+			_completion->Signal();
+			return false;
+		}
+		return true;
+	}
+
+	float ComputeTiledDispatch::GetProgress() const
+	{
+		return _tiles.empty() ? 1.0f : float(_recorded) / float(_tiles.size());
+	}
+
+	bool ComputeTiledDispatch::IsComplete() const
+	{
+		return _recorded == _tiles.size() && ComputeContext::Get()->GetFrame() >= _lastFrame + ComputeContext::MAX_FRAMES_IN_FLIGHT;
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "UltraEngine.h"
+#include "ComputeShader.h"
+#include <atomic>
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	/// <summary>
+	/// A large dispatch split into tiles which are recorded over one or more frames, created by ComputeShader::BeginTiledDispatch.
+	/// The tiles are recorded by the frame hook of ComputeContext, the object can be polled from the game thread.
+	/// </summary>
+	class ComputeTiledDispatch : public Object
+	{
+	private:
+		shared_ptr<ComputeShader> _shader;
+		vector<ComputeTile> _tiles;
+		int _tilesPerFrame;
+		uint8_t _pushConstants[128];
+		size_t _pushConstantsSize = 0;
+		std::atomic<uint32_t> _recorded = 0;
+		std::atomic<uint64_t> _lastFrame = 0;
+		std::atomic<bool> _cancelled = false;
+		shared_ptr<ComputeCompletion> _completion;
+
+	public:
+		ComputeTiledDispatch(shared_ptr<ComputeShader> shader, int tx, int ty, int tz, int tileX, int tileY, int tileZ, int tilesPerFrame, const void* pushData, size_t pushDataSize);
+
+		// Records the tiles of this frame, returns false once there are none left
+		bool Record(VkCommandBuffer commandBuffer);
+
+		uint32_t CountTiles() const { return _tiles.size(); }
+		uint32_t CountRecordedTiles() const { return _recorded; }
+		// Fraction of the tiles recorded so far
+		float GetProgress() const;
+		// True once every tile was recorded and the frames have completed on the GPU
+		bool IsComplete() const;
+		// Stops recording further tiles, the ones already recorded still run
+		void Cancel() { _cancelled = true; }
+		// Completes once the last tile recorded has been executed, after all tiles or a cancel
+		shared_ptr<ComputeCompletion> GetCompletion() const { return _completion; }
+	};
+}
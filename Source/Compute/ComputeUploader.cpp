@@ -0,0 +1,182 @@
+#include "UltraEngine.h"
+#include "ComputeUploader.h"
+#include "ComputeMemoryStats.h"
+#include <algorithm>
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	shared_ptr<ComputeUploader> ComputeUploader::Get()
+	{
+		static shared_ptr<ComputeUploader> uploader = make_shared<ComputeUploader>();
+		return uploader;
+	}
+
+	void ComputeUploader::init()
+	{
+		if (_initialized)
+		{
+			return;
+		}
+		_initialized = true;
+
+		VkPhysicalDevice physicalDevice = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device->physicaldevice;
+		VkPhysicalDeviceMemoryProperties properties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties);
+
+		const VkMemoryPropertyFlags mappable = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		for (uint32_t i = 0; i < properties.memoryTypeCount; i++)
+		{
+			if ((properties.memoryTypes[i].propertyFlags & mappable) == mappable
+				&& properties.memoryHeaps[properties.memoryTypes[i].heapIndex].size >= MIN_REBAR_HEAP_SIZE)
+			{
+				_targetMemory = mappable;
+				break;
+			}
+		}
+	}
+
+	VkMemoryPropertyFlags ComputeUploader::GetTargetMemory()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		init();
+		return _targetMemory;
+	}
+
+	bool ComputeUploader::Write(ComputeBuffer& buffer, const void* data, VkDeviceSize size, VkDeviceSize offset)
+	{
+		if (size == 0)
+		{
+			return false;
+		}
+
+		// host visible memory is not written directly either, earlier frames still in flight may be reading it
+		Upload(buffer.buffer, offset, data, size);
+		return true;
+	}
+
+	void ComputeUploader::Upload(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_pending.push_back({ buffer, offset, size, _pendingData.size() });
+		auto bytes = static_cast<const uint8_t*>(data);
+		_pendingData.insert(_pendingData.end(), bytes, bytes + size);
+	}
+
+	bool ComputeUploader::HasPending()
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		return !_pending.empty();
+	}
+
+	ComputeBuffer& ComputeUploader::getStaging(VkDeviceSize size, VkDeviceSize& offset)
+	{
+		uint64_t frame = ComputeContext::Get()->GetFrame();
+		auto& staging = _staging[frame % ComputeContext::MAX_FRAMES_IN_FLIGHT];
+		if (frame != _stagingFrame)
+		{
+			// the last frame which used this buffer has completed
+			_stagingFrame = frame;
+			_stagingOffset = 0;
+		}
+
+		if (staging.buffer == VK_NULL_HANDLE || _stagingOffset + size > staging.size)
+		{
+			if (staging.buffer != VK_NULL_HANDLE)
+			{
+				// copies recorded earlier in this frame still read the old buffer
+				ComputeContext::Get()->Retire(staging);
+			}
+
+			VkDeviceSize capacity = std::max(MIN_STAGING_SIZE, staging.size);
+			while (capacity < size)
+			{
+				capacity *= 2;
+			}
+			staging = ComputeBuffer();
+			ComputeMemoryScope scope("ComputeUploader");
+			VK_CHECK_RESULT(initializers::createBuffer(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, &staging, capacity, nullptr));
+			_stagingOffset = 0;
+		}
+
+		offset = _stagingOffset;
+		_stagingOffset += size;
+		return staging;
+	}
+
+	void ComputeUploader::Flush(VkCommandBuffer commandBuffer)
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			std::swap(_pending, _copies);
+			std::swap(_pendingData, _copyData);
+		}
+		if (_copies.empty())
+		{
+			return;
+		}
+
+		VkDeviceSize stagingOffset;
+		auto& staging = getStaging(_copyData.size(), stagingOffset);
+		staging.write(_copyData.data(), _copyData.size(), stagingOffset);
+
+		// dispatches recorded earlier may still read the destinations
+		VkMemoryBarrier barrier = initializers::memoryBarrier();
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		// one copy command per buffer, later writes to the same buffer stay behind earlier ones
+		std::stable_sort(_copies.begin(), _copies.end(), [](const PendingCopy& a, const PendingCopy& b) { return a.buffer < b.buffer; });
+
+		size_t first = 0;
+		for (size_t i = 0; i <= _copies.size(); i++)
+		{
+			bool flush = i == _copies.size() || _copies[i].buffer != _copies[first].buffer;
+			bool overlaps = false;
+			if (!flush)
+			{
+				for (size_t n = first; n < i; n++)
+				{
+					if (_copies[n].offset < _copies[i].offset + _copies[i].size && _copies[i].offset < _copies[n].offset + _copies[n].size)
+					{
+						overlaps = true;
+						break;
+					}
+				}
+			}
+			if (!flush && !overlaps)
+			{
+				continue;
+			}
+
+			_regions.clear();
+			for (size_t n = first; n < i; n++)
+			{
+				VkBufferCopy region;
+				region.srcOffset = stagingOffset + _copies[n].source;
+				region.dstOffset = _copies[n].offset;
+				region.size = _copies[n].size;
+				_regions.push_back(region);
+			}
+			vkCmdCopyBuffer(commandBuffer, staging.buffer, _copies[first].buffer, static_cast<uint32_t>(_regions.size()), _regions.data());
+
+			if (overlaps)
+			{
+				// the regions of a copy must not overlap, a rewritten range goes into a copy of its own after the first one
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+			}
+			first = i;
+		}
+
+		// shaders may write the buffers as well, their writes must not race the copy
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		_copies.clear();
+		_copyData.clear();
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "UltraEngine.h"
+#include "VulkanUtils.h"
+#include "ComputeContext.h"
+#include <mutex>
+
+using namespace UltraEngine;
+using namespace UltraEngine::Compute::Utils;
+
+namespace UltraEngine::Compute
+{
+	/// <summary>
+	/// Moves data into device local buffers. Writes are collected from any thread and recorded on the rendering thread as one
+	/// batch: the data of all of them is packed into the staging buffer of the frame, each destination buffer receives a single
+	/// vkCmdCopyBuffer with all its regions and one barrier makes the copies visible to the compute shaders.
+	/// ComputeContext flushes the batch at the beginning of every frame, before the frame's dispatches.
+	///
+	/// Where the device has resizable BAR (a large device local heap which is host visible) or unified memory, the buffers
+	/// are allocated host visible so they are read back directly. Writes still go through the batch: the frames in flight
+	/// may read the buffer, a direct write would change their data.
+	/// </summary>
+	class ComputeUploader : public Object
+	{
+	public:
+		// Device local heaps up to this size which are host visible are the 256 MB BAR window, not worth spending on buffers
+		static constexpr VkDeviceSize MIN_REBAR_HEAP_SIZE = 256ull * 1024 * 1024 + 1;
+		static constexpr VkDeviceSize MIN_STAGING_SIZE = 1024 * 1024;
+
+	private:
+		struct PendingCopy
+		{
+			VkBuffer buffer;
+			VkDeviceSize offset;
+			VkDeviceSize size;
+			// position of the data in _pendingData
+			size_t source;
+		};
+
+		std::mutex _mutex;
+		vector<PendingCopy> _pending;
+		vector<uint8_t> _pendingData;
+
+		// rendering thread only, one staging buffer per frame in flight
+		ComputeBuffer _staging[ComputeContext::MAX_FRAMES_IN_FLIGHT];
+		// the batches of a frame are packed one after the other
+		uint64_t _stagingFrame = 0;
+		VkDeviceSize _stagingOffset = 0;
+		vector<PendingCopy> _copies;
+		vector<uint8_t> _copyData;
+		vector<VkBufferCopy> _regions;
+
+		bool _initialized = false;
+		VkMemoryPropertyFlags _targetMemory = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+		void init();
+		ComputeBuffer& getStaging(VkDeviceSize size, VkDeviceSize& offset);
+
+	public:
+		static shared_ptr<ComputeUploader> Get();
+
+		// Memory properties of buffers written through the uploader: device local, and host visible where that is fast
+		VkMemoryPropertyFlags GetTargetMemory();
+
+		// Writes the data to the buffer through the next batch, ordered with the frames which use it. The data is copied.
+		// Returns true if the write was queued.
+		bool Write(ComputeBuffer& buffer, const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+		// Queues a copy to any buffer created with VK_BUFFER_USAGE_TRANSFER_DST_BIT
+		void Upload(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+		bool HasPending();
+
+		// Records the queued copies, called on the rendering thread outside of a render pass
+		void Flush(VkCommandBuffer commandBuffer);
+	};
+}
@@ -0,0 +1,103 @@
+#include "UltraEngine.h"
+#include "MipGenerator.h"
+#include "ComputeFormat.h"
+#include "Generated/EmbeddedShaders.h"
+
+using namespace std;
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	// The storage format is part of the shader, every supported format has its own variant
+	static bool getShaderCode(VkFormat format, const uint32_t*& code, size_t& size)
+	{
+		switch (format)
+		{
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			code = EmbeddedShaders::generate_mips;
+			size = sizeof(EmbeddedShaders::generate_mips);
+			return true;
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			code = EmbeddedShaders::generate_mips_rgba16f;
+			size = sizeof(EmbeddedShaders::generate_mips_rgba16f);
+			return true;
+		case VK_FORMAT_R8G8B8A8_UNORM:
+			code = EmbeddedShaders::generate_mips_rgba8;
+			size = sizeof(EmbeddedShaders::generate_mips_rgba8);
+			return true;
+		case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+			code = EmbeddedShaders::generate_mips_r11g11b10f;
+			size = sizeof(EmbeddedShaders::generate_mips_r11g11b10f);
+			return true;
+		}
+		return false;
+	}
+
+	MipGenerator::MipGenerator(Passkey, shared_ptr<Texture> texture, const uint32_t* code, size_t codeSize)
+	{
+		_texture = texture;
+		_layers = texture->CountFaces();
+
+		// every workgroup reduces a 64x64 tile of the base level
+		_workGroupsX = (texture->GetSize().x + 63) / 64;
+		_workGroupsY = (texture->GetSize().y + 63) / 64;
+
+		_constants.mipCount = std::min(int(texture->CountMipmaps()), MAX_MIPS) - 1;
+		_constants.workGroupCount = _workGroupsX * _workGroupsY;
+
+		_shader = ComputeShader::CreateFromMemory(code, codeSize);
+		_shader->AddTargetImageMips(texture, 0, MAX_MIPS, true);
+		// one atomic counter per layer, the last workgroup resets it after use
+		_shader->AddStorageBuffer(nullptr, _layers * sizeof(uint32_t));
+		_shader->SetupPushConstant(sizeof(MipGeneratorConstants));
+	}
+
+	shared_ptr<MipGenerator> MipGenerator::Create(shared_ptr<Texture> texture)
+	{
+		if (texture->GetSize().x > MAX_SIZE || texture->GetSize().y > MAX_SIZE)
+		{
+			Print("Error: MipGenerator supports base levels up to " + std::to_string(MAX_SIZE) + " texels, the texture is "
+				+ std::to_string(texture->GetSize().x) + "x" + std::to_string(texture->GetSize().y));
+			return nullptr;
+		}
+
+		const uint32_t* code = nullptr;
+		size_t size = 0;
+		if (!getShaderCode(VkFormat(texture->GetFormat()), code, size))
+		{
+			Print("Error: MipGenerator has no shader for texture format " + std::to_string(int(texture->GetFormat()))
+				+ ", use rgba32f, rgba16f, rgba8 or r11g11b10f");
+			return nullptr;
+		}
+		// r11g11b10f is an extended storage format
+		if (!IsStorageFormatSupported(texture->GetFormat()))
+		{
+			Print("Error: MipGenerator can not write texture format " + std::to_string(int(texture->GetFormat()))
+				+ " as storage image, it needs EnableExtendedStorageFormats(true)");
+			return nullptr;
+		}
+
+		return make_shared<MipGenerator>(Passkey(), texture, code, size);
+	}
+
+	void MipGenerator::Dispatch(shared_ptr<World> world, bool oneTime, ComputeHook hook)
+	{
+		if (_constants.mipCount == 0)
+		{
+			return;
+		}
+
+		_shader->BeginDispatch(world, _workGroupsX, _workGroupsY, _layers, oneTime, hook, &_constants, sizeof(MipGeneratorConstants));
+	}
+
+	shared_ptr<MipGenerator> GenerateMips(shared_ptr<World> world, shared_ptr<Texture> texture, ComputeHook hook)
+	{
+		auto generator = MipGenerator::Create(texture);
+		if (generator == nullptr)
+		{
+			return nullptr;
+		}
+		generator->Dispatch(world, true, hook);
+		return generator;
+	}
+}
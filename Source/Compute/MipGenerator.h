@@ -0,0 +1,56 @@
+#pragma once
+#include "UltraEngine.h"
+#include "ComputeShader.h"
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	struct MipGeneratorConstants
+	{
+		uint32_t mipCount;
+		uint32_t workGroupCount;
+	};
+
+	/// <summary>
+	/// Builds the whole mip chain of a storage texture in a single dispatch (Shaders/Compute/generate_mips.comp).
+	/// Supports 2D, array and cube textures, the base level can be up to 4096 texels wide.
+	/// rgba32f, rgba16f, rgba8 and r11g11b10f textures have their own shader variant, Create fails for other formats.
+	/// r11g11b10f also needs EnableExtendedStorageFormats(true).
+	/// Keep the generator around for textures which are regenerated regularly, it owns the pipeline.
+	/// </summary>
+	class MipGenerator : public Object
+	{
+	public:
+		// Only Create can construct a generator, it rejects textures the shader can not handle
+		class Passkey
+		{
+			friend class MipGenerator;
+			Passkey() = default;
+		};
+
+	private:
+		shared_ptr<ComputeShader> _shader;
+		shared_ptr<Texture> _texture;
+		MipGeneratorConstants _constants;
+		int _workGroupsX;
+		int _workGroupsY;
+		int _layers;
+
+	public:
+		// Size of the image array in the shader, the base level plus 12 generated levels
+		static constexpr int MAX_MIPS = 13;
+		// Largest base level, the last workgroup reduces at most 64x64 texels of mip 6
+		static constexpr int MAX_SIZE = 4096;
+
+		MipGenerator(Passkey, shared_ptr<Texture> texture, const uint32_t* code, size_t codeSize);
+		// Returns nullptr if the texture is larger than MAX_SIZE or its format has no shader variant or is no enabled storage format
+		static shared_ptr<MipGenerator> Create(shared_ptr<Texture> texture);
+
+		void Dispatch(shared_ptr<World> world, bool oneTime = true, ComputeHook hook = ComputeHook::TRANSFER);
+		shared_ptr<ComputeShader> GetShader() { return _shader; }
+	};
+
+	// Generates the mip chain of the texture once, returns the generator for later reuse or nullptr if it's not supported
+	shared_ptr<MipGenerator> GenerateMips(shared_ptr<World> world, shared_ptr<Texture> texture, ComputeHook hook = ComputeHook::TRANSFER);
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "UltraEngine.h"
+#include <atomic>
+#include <type_traits>
+
+using namespace UltraEngine;
+
+namespace UltraEngine::Compute
+{
+	/// <summary>
+	/// Type erased part of a ParameterBlock, used by the ComputeShader on the rendering thread.
+	/// </summary>
+	class ParameterBlockBase : public Object
+	{
+	public:
+		virtual size_t GetSize() const = 0;
+		// Rendering thread only: makes the latest published version the front buffer, returns false if nothing new was published
+		virtual bool Acquire() = 0;
+		// Rendering thread only: the data which was acquired last
+		virtual const void* GetFront() const = 0;
+	};
+
+	/// <summary>
+	/// Lock-free triple buffer for uniform data shared between the game and the rendering thread.
+	/// The game thread modifies the data returned by Edit() and calls Publish(), the rendering thread
+	/// always consumes the latest complete version. Neither side ever waits for the other one.
+	/// </summary>
+	template <typename T>
+	class ParameterBlock : public ParameterBlockBase
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "ParameterBlock data must be trivially copyable");
+
+		// _state holds the index of the middle slot in the lower bits and the DIRTY_BIT when it contains unconsumed data
+		static constexpr uint8_t INDEX_MASK = 0x3;
+		static constexpr uint8_t DIRTY_BIT = 0x4;
+
+		T _slots[3];
+		uint8_t _back = 0;
+		uint8_t _front = 2;
+		std::atomic<uint8_t> _state;
+
+	public:
+		ParameterBlock(const T& initial)
+		{
+			_slots[0] = initial;
+			_slots[1] = initial;
+			_slots[2] = initial;
+			_state.store(1, std::memory_order_relaxed);
+		}
+
+		// Game thread only: the version which will be published next
+		T& Edit()
+		{
+			return _slots[_back];
+		}
+
+		// Game thread only: hands the edited version over to the rendering thread
+		void Publish()
+		{
+			uint8_t published = _back;
+			_back = _state.exchange(published | DIRTY_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+			// keep editing on top of the version which was just published
+			_slots[_back] = _slots[published];
+		}
+
+		void Publish(const T& value)
+		{
+			_slots[_back] = value;
+			Publish();
+		}
+
+		size_t GetSize() const override
+		{
+			return sizeof(T);
+		}
+
+		bool Acquire() override
+		{
+			if ((_state.load(std::memory_order_relaxed) & DIRTY_BIT) == 0)
+			{
+				return false;
+			}
+
+			_front = _state.exchange(_front, std::memory_order_acq_rel) & INDEX_MASK;
+			return true;
+		}
+
+		const void* GetFront() const override
+		{
+			return &_slots[_front];
+		}
+	};
+
+	template <typename T>
+	shared_ptr<ParameterBlock<T>> CreateParameterBlock(const T& initial = T())
+	{
+		return std::make_shared<ParameterBlock<T>>(initial);
+	}
+}
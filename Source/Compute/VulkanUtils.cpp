@@ -1,8 +1,9 @@
 #include "UltraEngine.h"
 #include "VulkanUtils.h"
 #include "ComputeShader.h"
+#include "ComputeMemoryStats.h"
 
-VkResult UltraEngine::Compute::Utils::initializers::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, VkDeviceMemory* memory, void* data)
+VkResult UltraEngine::Compute::Utils::initializers::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, VkDeviceMemory* memory, const void* data)
 {
 	auto device = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device;
 	// Create the buffer handle
@@ -50,7 +51,7 @@ VkResult UltraEngine::Compute::Utils::initializers::createBuffer(VkBufferUsageFl
 	return VK_SUCCESS;
 }
 
-VkResult UltraEngine::Compute::Utils::initializers::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, ComputeBuffer* buffer, VkDeviceSize size, void* data)
+VkResult UltraEngine::Compute::Utils::initializers::createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, ComputeBuffer* buffer, VkDeviceSize size, const void* data)
 {
 	auto logicalDevice = UltraEngine::Core::GameEngine::Get()->renderingthreadmanager->device;
 
@@ -76,17 +77,29 @@ VkResult UltraEngine::Compute::Utils::initializers::createBuffer(VkBufferUsageFl
 	}
 	result = vkAllocateMemory(logicalDevice->device, &memAlloc, nullptr, &buffer->memory);
 
+	// the memory type may have more properties than requested, e.g. host coherent when only host visible was asked for
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(logicalDevice->physicaldevice, &memoryProperties);
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(logicalDevice->physicaldevice, &deviceProperties);
+
 	buffer->alignment = memReqs.alignment;
+	buffer->allocationSize = memReqs.size;
+	buffer->nonCoherentAtomSize = deviceProperties.limits.nonCoherentAtomSize;
 	buffer->size = size;
 	buffer->usageFlags = usageFlags;
-	buffer->memoryPropertyFlags = memoryPropertyFlags;
+	buffer->memoryPropertyFlags = memoryProperties.memoryTypes[memAlloc.memoryTypeIndex].propertyFlags;
+
+	auto type = (usageFlags & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) ? ComputeResourceType::STORAGE_BUFFER
+		: (usageFlags & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) ? ComputeResourceType::UNIFORM_BUFFER : ComputeResourceType::STAGING_BUFFER;
+	ComputeMemoryStats::Get()->Track((uint64_t)buffer->memory, type, memReqs.size, memoryProperties.memoryTypes[memAlloc.memoryTypeIndex].heapIndex);
 
 	// If a pointer to the buffer data has been passed, map the buffer and copy over the data
 	if (data != nullptr)
 	{
 		buffer->map();
 		memcpy(buffer->mapped, data, size);
-		if ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
+		if (!buffer->isCoherent())
 			buffer->flush();
 
 		buffer->unmap();
@@ -159,7 +172,7 @@ void ComputeBuffer::setupDescriptor(VkDeviceSize size, VkDeviceSize offset)
 * @param size Size of the data to copy in machine units
 *
 */
-void ComputeBuffer::copyTo(void* data, VkDeviceSize size)
+void ComputeBuffer::copyTo(const void* data, VkDeviceSize size)
 {
 	assert(mapped);
 	memcpy(mapped, data, size);
@@ -205,6 +218,90 @@ VkResult ComputeBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset)
 	return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
 }
 
+/**
+* Copies data into a range of the buffer, only the range is mapped
+*
+* @note Non-coherent memory is flushed, the flushed range is widened to multiples of nonCoherentAtomSize
+*
+* @param data Pointer to the data to copy
+* @param size Size of the data to copy in machine units
+* @param offset (Optional) Byte offset from beginning
+*
+*/
+void ComputeBuffer::write(const void* data, VkDeviceSize size, VkDeviceSize offset)
+{
+	VkDeviceSize begin = offset;
+	VkDeviceSize end = offset + size;
+	if (!isCoherent())
+	{
+		begin = offset / nonCoherentAtomSize * nonCoherentAtomSize;
+		end = std::min((end + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize, allocationSize);
+	}
+
+	map(end - begin, begin);
+	memcpy(static_cast<uint8_t*>(mapped) + (offset - begin), data, size);
+	if (!isCoherent())
+	{
+		// a range reaching the end of the allocation does not have to be a multiple of the atom size
+		flush(end == allocationSize ? VK_WHOLE_SIZE : end - begin, begin);
+	}
+	unmap();
+}
+
+/**
+* Copies a range of the buffer to the host, only the range is mapped
+*
+* @note Non-coherent memory is invalidated first, the invalidated range is widened to multiples of nonCoherentAtomSize
+*
+* @param data Pointer receiving the data
+* @param size Size of the data to copy in machine units
+* @param offset (Optional) Byte offset from beginning
+*
+*/
+void ComputeBuffer::read(void* data, VkDeviceSize size, VkDeviceSize offset)
+{
+	VkDeviceSize begin = offset;
+	VkDeviceSize end = offset + size;
+	if (!isCoherent())
+	{
+		begin = offset / nonCoherentAtomSize * nonCoherentAtomSize;
+		end = std::min((end + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize, allocationSize);
+	}
+
+	map(end - begin, begin);
+	if (!isCoherent())
+	{
+		invalidate(end == allocationSize ? VK_WHOLE_SIZE : end - begin, begin);
+	}
+	memcpy(data, static_cast<uint8_t*>(mapped) + (offset - begin), size);
+	unmap();
+}
+
+/**
+* Get the device address of the buffer, e.g. to pass it to GL_EXT_buffer_reference shaders in push constants
+*
+* @note The buffer must have been created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+*
+* @return The 64 bit address of the start of the buffer, 0 if it has no device address
+*/
+VkDeviceAddress ComputeBuffer::GetDeviceAddress() const
+{
+	if (buffer == VK_NULL_HANDLE || (usageFlags & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) == 0)
+	{
+		return 0;
+	}
+
+	VkBufferDeviceAddressInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+	info.buffer = buffer;
+	return vkGetBufferDeviceAddress(device, &info);
+}
+
+TimeStampQuery::~TimeStampQuery()
+{
+	UltraEngine::Compute::ComputeContext::Get()->Retire(_queryPool);
+}
+
 /**
 * Release all Vulkan resources held by this buffer
 */
@@ -216,6 +313,7 @@ void ComputeBuffer::destroy()
 	}
 	if (memory)
 	{
+		UltraEngine::Compute::ComputeMemoryStats::Get()->Untrack((uint64_t)memory);
 		vkFreeMemory(device, memory, nullptr);
 	}
 }
@@ -328,6 +426,15 @@ namespace UltraEngine::Compute::Utils
 			return false;
 		}
 
+		// Returns if a given format can be used as storage image
+		VkBool32 formatIsStorage(VkPhysicalDevice physicalDevice, VkFormat format)
+		{
+			VkFormatProperties formatProps;
+			vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProps);
+
+			return formatProps.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+		}
+
 		// Create an image memory barrier for changing the layout of
 		// an image and put it into an active command buffer
 		// See chapter 11.4 "Image Layout" for details
@@ -526,6 +633,30 @@ namespace UltraEngine::Compute::Utils
 		{
 			return (value + alignment - 1) & ~(alignment - 1);
 		}
+
+		VkShaderModule loadShaderModule(VkDevice device, const uint32_t* code, size_t codeSize)
+		{
+			// e.g. the placeholder of a shader embedded without the Vulkan SDK, see Shaders/Compute/compile.bat
+			if (code == nullptr || codeSize < 5 * sizeof(uint32_t) || code[0] != 0x07230203)
+			{
+				Print("Error: Failed to create shader module: the code is not SPIR-V");
+				return VK_NULL_HANDLE;
+			}
+
+			VkShaderModuleCreateInfo moduleCreateInfo{};
+			moduleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+			moduleCreateInfo.codeSize = codeSize;
+			moduleCreateInfo.pCode = code;
+
+			VkShaderModule shaderModule = VK_NULL_HANDLE;
+			VkResult result = vkCreateShaderModule(device, &moduleCreateInfo, nullptr, &shaderModule);
+			if (result != VK_SUCCESS)
+			{
+				Print("Error: Failed to create shader module: " + errorString(result));
+				return VK_NULL_HANDLE;
+			}
+			return shaderModule;
+		}
 	}
 }
 
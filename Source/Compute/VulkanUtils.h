@@ -36,6 +36,8 @@ namespace UltraEngine::Compute::Utils
 
 		// Returns tru a given format support LINEAR filtering
 		VkBool32 formatIsFilterable(VkPhysicalDevice physicalDevice, VkFormat format, VkImageTiling tiling);
+		// Returns true if a given format can be used as storage image with optimal tiling
+		VkBool32 formatIsStorage(VkPhysicalDevice physicalDevice, VkFormat format);
 		// Returns true if a given format has a stencil part
 		VkBool32 formatHasStencil(VkFormat format);
 
@@ -76,6 +78,9 @@ namespace UltraEngine::Compute::Utils
 
 
 		uint32_t alignedSize(uint32_t value, uint32_t alignment);
+
+		// Creates a shader module from SPIR-V code, codeSize is given in bytes
+		VkShaderModule loadShaderModule(VkDevice device, const uint32_t* code, size_t codeSize);
 	}
 
 	namespace initializers
@@ -718,8 +723,8 @@ namespace UltraEngine::Compute::Utils
 			return writeDescriptorSetAccelerationStructureKHR;
 		}
 
-		VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, VkDeviceMemory* memory, void* data = nullptr);
-		VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, ComputeBuffer* buffer, VkDeviceSize size, void* data = nullptr);
+		VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer* buffer, VkDeviceMemory* memory, const void* data = nullptr);
+		VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, ComputeBuffer* buffer, VkDeviceSize size, const void* data = nullptr);
 	}
 
 	class TimeStampQuery : public Object
@@ -729,13 +734,15 @@ namespace UltraEngine::Compute::Utils
 		bool _supported;
 		VkPhysicalDeviceProperties deviceProperties;
 		VkPhysicalDeviceFeatures deviceFeatures;
-		VkQueryPool _queryPool;
+		VkQueryPool _queryPool = VK_NULL_HANDLE;
 		VkDevice _device;
 	public:
 		TimeStampQuery()
 		{
 			_initialized = false;
 		}
+		// The query pool is retired through ComputeContext
+		~TimeStampQuery();
 
 		void Init(VkPhysicalDevice physicalDevice, VkDevice device)
 		{
@@ -779,6 +786,22 @@ namespace UltraEngine::Compute::Utils
 			auto tp = deviceProperties.limits.timestampPeriod;
 			return timestamps;
 		}
+
+		// Returns false instead of waiting if the GPU has not written the timestamps yet
+		bool TryGetQueryPoolResults(std::array<uint64_t, 2>& timestamps)
+		{
+			if (!_initialized || _queryPool == VK_NULL_HANDLE)
+			{
+				return false;
+			}
+			return vkGetQueryPoolResults(_device, _queryPool, 0, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+		}
+
+		// Nanoseconds per timestamp tick
+		float GetPeriod() const
+		{
+			return _initialized ? deviceProperties.limits.timestampPeriod : 1.0f;
+		}
 	};
 
 
@@ -790,18 +813,27 @@ namespace UltraEngine::Compute::Utils
 		VkDescriptorBufferInfo descriptor;
 		VkDeviceSize size = 0;
 		VkDeviceSize alignment = 0;
+		/** @brief Size of the memory allocation, which may be larger than the buffer */
+		VkDeviceSize allocationSize = 0;
+		/** @brief Alignment of flushed and invalidated ranges, only used for memory without VK_MEMORY_PROPERTY_HOST_COHERENT_BIT */
+		VkDeviceSize nonCoherentAtomSize = 1;
 		void* mapped = nullptr;
 		/** @brief Usage flags to be filled by external source at buffer creation (to query at some later point) */
 		VkBufferUsageFlags usageFlags;
-		/** @brief Memory property flags to be filled by external source at buffer creation (to query at some later point) */
+		/** @brief Memory property flags of the memory type the buffer was allocated from */
 		VkMemoryPropertyFlags memoryPropertyFlags;
 		VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 		void unmap();
 		VkResult bind(VkDeviceSize offset = 0);
 		void setupDescriptor(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
-		void copyTo(void* data, VkDeviceSize size);
+		void copyTo(const void* data, VkDeviceSize size);
 		VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 		VkResult invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+		void write(const void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+		void read(void* data, VkDeviceSize size, VkDeviceSize offset = 0);
+		bool isCoherent() const { return (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0; }
+		VkDeviceAddress GetDeviceAddress() const;
+		/** @brief Frees the buffer right away, buffers the GPU may still use are handed to ComputeContext::Retire instead */
 		void destroy();
 	};
 
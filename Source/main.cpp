@@ -1,6 +1,12 @@
 #include "UltraEngine.h"
 #include "Components/Mover.hpp"
+#include "Components/MoverSystem.h"
 #include "Compute/ComputeShader.h"
+#include "Compute/ComputeShaderWatcher.h"
+#include "Compute/ComputeFormat.h"
+#include "Compute/ComputeBenchmark.h"
+#include "Compute/ComputeTelemetry.h"
+#include "Compute/Generated/EmbeddedShaders.h"
 
 using namespace UltraEngine;
 using namespace UltraEngine::Compute;
@@ -19,6 +25,13 @@ struct SampleComputeParameters
     Vec4 color;
 };
 
+// Resumed by ComputeContext::Pump once the GPU has executed the dispatch
+ComputeTask ReportDispatch(shared_ptr<ComputeCompletion> completion, const String& name)
+{
+    co_await completion;
+    Print(name + " dispatch completed");
+}
+
 int main(int argc, const char* argv[])
 {
     //Get the displays
@@ -44,6 +57,38 @@ int main(int argc, const char* argv[])
     light->SetRotation(35, 45, 0);
     light->SetRange(-10, 10);
 
+    // Add -deviceaddress if the engine's device was created with the bufferDeviceAddress feature, storage buffers then
+    // get device addresses for GL_EXT_buffer_reference kernels
+    for (int n = 1; n < argc; n++)
+    {
+        if (string(argv[n]) == "-deviceaddress")
+        {
+            ComputeStorageBuffer::EnableDeviceAddresses(true);
+        }
+        // Likewise -bindless if it was created with the descriptor indexing features ComputeBindlessHeap needs
+        if (string(argv[n]) == "-bindless")
+        {
+            ComputeBindlessHeap::Enable(true);
+        }
+        // and -extendedformats if it enabled shaderStorageImageExtendedFormats
+        if (string(argv[n]) == "-extendedformats")
+        {
+            EnableExtendedStorageFormats(true);
+        }
+    }
+
+    // Start with -benchmark to compare the compute primitives with their CPU counterparts
+    for (int n = 1; n < argc; n++)
+    {
+        if (string(argv[n]) == "-benchmark")
+        {
+            RunPrimitiveBenchmarks(world, framebuffer);
+            RunSortBenchmarks(world, framebuffer);
+            RunBufferReferenceBenchmarks(world, framebuffer);
+            return 0;
+        }
+    }
+
 
     SampleComputeParameters sampleParameters;
     sampleParameters.size = 64.0;
@@ -52,19 +97,32 @@ int main(int argc, const char* argv[])
     // Create a first computeshader for uniform buffer usage
     // Normally you will use uniform buffers for data which is not changing, this is just for showcase 
     // and shows that the data can still be updated at runtime
-    auto sampleComputePipeLine_Unifom = ComputeShader::Create("Shaders/Compute/simple_test.comp.spv");
-    auto targetTexture_uniform = CreateTexture(TEXTURE_2D, 512, 512, TEXTURE_RGBA32, {}, 1, TEXTURE_STORAGE, TEXTUREFILTER_LINEAR);
+    // The SPIR-V is compiled, optimized and embedded into the executable by the pre-build step (Shaders/Compute/compile.bat)
+    // The sample shaders write rgba16f (8 bytes per texel), a required storage format which GetStorageFormat never has to fall back from
+    auto storageFormat = GetStorageFormat(ComputePrecision::HALF);
+    auto sampleComputePipeLine_Unifom = ComputeShader::CreateFromMemory(EmbeddedShaders::simple_test, sizeof(EmbeddedShaders::simple_test));
+    sampleComputePipeLine_Unifom->SetName("simple_test");
+    auto targetTexture_uniform = CreateTexture(TEXTURE_2D, 512, 512, storageFormat, {}, 1, TEXTURE_STORAGE, TEXTUREFILTER_LINEAR);
     // Now we define the descriptor layout, the binding is resolved by the order in which the items are added
     sampleComputePipeLine_Unifom->AddTargetImage(targetTexture_uniform); // Seting up a target image --> layout 0
-    sampleComputePipeLine_Unifom->AddUniformBuffer(&sampleParameters, sizeof(SampleComputeParameters), false); // Seting up a uniform bufffer --> layout 1
+    // The parameter block is written by the game thread and consumed by the render thread without any locking
+    auto uniformParameters = CreateParameterBlock(sampleParameters);
+    sampleComputePipeLine_Unifom->AddParameterBlock(uniformParameters); // Seting up a uniform bufffer --> layout 1
 
     // Create a first computeshader for push constant usage
     // This is the better way to pass dynamic data
-    auto sampleComputePipeLine_Push = ComputeShader::Create("Shaders/Compute/simple_test_push.comp.spv");
-    auto targetTexture_push= CreateTexture(TEXTURE_2D, 512, 512, TEXTURE_RGBA32, {}, 1, TEXTURE_STORAGE, TEXTUREFILTER_LINEAR);
+    auto sampleComputePipeLine_Push = ComputeShader::CreateFromMemory(EmbeddedShaders::simple_test_push, sizeof(EmbeddedShaders::simple_test_push));
+    sampleComputePipeLine_Push->SetName("simple_test_push");
+    auto targetTexture_push= CreateTexture(TEXTURE_2D, 512, 512, storageFormat, {}, 1, TEXTURE_STORAGE, TEXTUREFILTER_LINEAR);
     sampleComputePipeLine_Push->AddTargetImage(targetTexture_push);
     sampleComputePipeLine_Push->SetupPushConstant(sizeof(SampleComputeParameters)); // Currently used to initalize the pipeline, may change in the future
 
+#ifdef _DEBUG
+    // Edit the .comp files while the sample is running, they are recompiled and swapped in without a restart
+    ComputeShaderWatcher::Get()->Watch(sampleComputePipeLine_Unifom, "Shaders/Compute/simple_test.comp");
+    ComputeShaderWatcher::Get()->Watch(sampleComputePipeLine_Push, "Shaders/Compute/simple_test_push.comp");
+#endif
+
     // For demonstration the push based shader is executed continously
     // The push-constant data is passed here
     sampleComputePipeLine_Push->BeginDispatch(world, targetTexture_uniform->GetSize().x / 16.0, targetTexture_uniform->GetSize().y / 16.0, 1, false, ComputeHook::TRANSFER, &sampleParameters, sizeof(SampleComputeParameters));
@@ -95,6 +153,11 @@ int main(int argc, const char* argv[])
     auto component_push = box_push->AddComponent<Mover>();
     component_push->rotationspeed.y = 45;
 
+    // The movers are updated together in one batched pass per frame instead of one component update each
+    auto movers = MoverSystem::Create(world);
+    movers->Add(component_uniform);
+    movers->Add(component_push);
+
     auto camera2D = CreateCamera(world, UltraEngine::PROJECTION_ORTHOGRAPHIC);
     camera2D->SetDepthPrepass(false);
     camera2D->SetClearMode(UltraEngine::CLEAR_DEPTH);
@@ -113,6 +176,20 @@ int main(int argc, const char* argv[])
     sprite->SetRenderLayers(1);
     sprite->SetPosition(20, window->GetSize().height - 45);
 
+    // GPU time, dispatches, descriptor writes and uploads of the shaders, drawn by camera2D below the sample text
+    // Start with -telemetry <file> to also log them as CSV
+    auto telemetry = ComputeTelemetry::Create(world, font, fontsize, 1);
+    telemetry->SetPosition(20, window->GetSize().height - 45 - fontsize * 5);
+    telemetry->Add(sampleComputePipeLine_Unifom);
+    telemetry->Add(sampleComputePipeLine_Push);
+    for (int n = 1; n < argc - 1; n++)
+    {
+        if (string(argv[n]) == "-telemetry")
+        {
+            telemetry->StartLog(argv[n + 1]);
+        }
+    }
+
     world->RecordStats(true);
 
     //Main loop
@@ -120,41 +197,37 @@ int main(int argc, const char* argv[])
     {
         if (window->KeyHit(KEY_D1))
         {
-            // Modify the shader data
-            sampleParameters.size = 64.0;
-            sampleParameters.color = Vec4(1.0, 0.0, 0.0, 1.0);
-            sampleComputePipeLine_Unifom->Update(1); // Notify the uniform shader to update the buffer at layout binding 1
+            // Modify the shader data, publishing notifies the uniform shader to update the buffer at layout binding 1
+            uniformParameters->Edit().size = 64.0;
+            uniformParameters->Edit().color = Vec4(1.0, 0.0, 0.0, 1.0);
+            uniformParameters->Publish();
 
             // Queue the dispatch to the cmd-pipeline just once.
-            sampleComputePipeLine_Unifom->BeginDispatch(world, targetTexture_uniform->GetSize().x / 16.0, targetTexture_uniform->GetSize().y / 16.0, 1, true, ComputeHook::TRANSFER);
+            ReportDispatch(sampleComputePipeLine_Unifom->BeginDispatch(world, targetTexture_uniform->GetSize().x / 16.0, targetTexture_uniform->GetSize().y / 16.0, 1, true, ComputeHook::TRANSFER), "Red pattern");
         }
         if (window->KeyHit(KEY_D2))
         {
-            sampleParameters.size = 128.0;
-            sampleParameters.color = Vec4(1.0, 1.0, 0.0, 1.0);
-            sampleComputePipeLine_Unifom->Update(1);
+            uniformParameters->Edit().size = 128.0;
+            uniformParameters->Edit().color = Vec4(1.0, 1.0, 0.0, 1.0);
+            uniformParameters->Publish();
             sampleComputePipeLine_Unifom->BeginDispatch(world, targetTexture_uniform->GetSize().x / 16.0, targetTexture_uniform->GetSize().y / 16.0, 1, true, ComputeHook::TRANSFER);
         }
         if (window->KeyHit(KEY_D3))
         {
-            sampleParameters.size = 16.0;
-            sampleParameters.color = Vec4(0.0, 0.0, 1.0, 1.0);
-            sampleComputePipeLine_Unifom->Update(1);
+            uniformParameters->Edit().size = 16.0;
+            uniformParameters->Edit().color = Vec4(0.0, 0.0, 1.0, 1.0);
+            uniformParameters->Publish();
             sampleComputePipeLine_Unifom->BeginDispatch(world, targetTexture_uniform->GetSize().x / 16.0, targetTexture_uniform->GetSize().y / 16.0, 1, true, ComputeHook::TRANSFER);
         }
 
 
+        // Continuations of completed compute work, e.g. coroutines awaiting a dispatch
+        ComputeContext::Get()->Pump();
+
+        movers->Update();
         world->Update();
         world->Render(framebuffer);
-
-        // Collect the compute timings (returns the start and and times when the shaders are executed and finished)
-        auto result_uniform = sampleComputePipeLine_Unifom->GetQueryTimer()->GetQueryPoolResults();
-        auto result_push = sampleComputePipeLine_Push->GetQueryTimer()->GetQueryPoolResults();
-
-        window->SetText("ComputeSample: FPS - " + String(world->renderstats.framerate) 
-            + " ComputeTime_Uniform (ms) - " + String((result_uniform[1] - result_uniform[0]) / 1e+6f)
-            + " ComputeTime_Push (ms) - " + String((result_push[1] - result_push[0]) / 1e+6f));
-
+        telemetry->Update();
     }
     return 0;
 }
\ No newline at end of file